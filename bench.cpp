@@ -0,0 +1,468 @@
+/* Benchmark of the parser over a corpus of json files.
+
+   Builds as its own program, json.cpp being compiled along with it:
+
+       g++ -std=c++17 -O2 -pthread -DJSON_NO_MAIN bench.cpp -o bench
+
+   ./bench runs on a fixed generated corpus of a small, a medium and a
+   huge file; ./bench file... runs on the given files instead, e.g. the
+   ones of https://github.com/jdorfman/awesome-json-datasets. For every
+   file it reports parse, validate and serialize MB/s, the peak resident
+   memory of one parse and the heap allocations it makes. --compare also
+   times tokenizing alone, in MB/s: the baseline, the tokenizer this
+   parser started from, copied below, reading a stream one character at
+   a time; the tokenizer of json.cpp over the whole text, and driven by
+   the structural index. The last column is a whole parse from a stream
+   with operator>>, for scale. */
+
+#include "json.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+
+/* Every heap allocation of the program goes through here, the aligned
+   and nothrow forms too, all of them freed by free(). */
+static std::atomic<std::size_t> allocations{0};
+static std::atomic<std::size_t> allocated_bytes{0};
+
+/* nullptr when out of memory */
+static void *counted_alloc(std::size_t n, std::size_t alignment) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(n, std::memory_order_relaxed);
+    if (n == 0)
+        n = 1;
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(n);
+    /* aligned_alloc wants the size a multiple of the alignment */
+    return std::aligned_alloc(alignment, (n + alignment - 1) / alignment * alignment);
+}
+
+/* Out of line: inlined into a delete expression, free() looks to GCC
+   like the wrong deallocation of what the new expression returned. */
+__attribute__((noinline)) static void counted_free(void *p) noexcept {
+    std::free(p);
+}
+
+static void *counted_new(std::size_t n, std::size_t alignment) {
+    if (void *p = counted_alloc(n, alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t n) {
+    return counted_new(n, 0);
+}
+
+void *operator new[](std::size_t n) {
+    return counted_new(n, 0);
+}
+
+void *operator new(std::size_t n, std::align_val_t a) {
+    return counted_new(n, static_cast<std::size_t>(a));
+}
+
+void *operator new[](std::size_t n, std::align_val_t a) {
+    return counted_new(n, static_cast<std::size_t>(a));
+}
+
+void *operator new(std::size_t n, std::nothrow_t const &) noexcept {
+    return counted_alloc(n, 0);
+}
+
+void *operator new[](std::size_t n, std::nothrow_t const &) noexcept {
+    return counted_alloc(n, 0);
+}
+
+void *operator new(std::size_t n, std::align_val_t a, std::nothrow_t const &) noexcept {
+    return counted_alloc(n, static_cast<std::size_t>(a));
+}
+
+void *operator new[](std::size_t n, std::align_val_t a, std::nothrow_t const &) noexcept {
+    return counted_alloc(n, static_cast<std::size_t>(a));
+}
+
+void operator delete(void *p) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::nothrow_t const &) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::nothrow_t const &) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::align_val_t, std::nothrow_t const &) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, std::nothrow_t const &) noexcept {
+    counted_free(p);
+}
+
+struct corpus_file {
+    std::string name;
+    std::string text;
+};
+
+/* a deterministic stream of pseudo random numbers */
+class generator {
+public:
+    std::uint64_t next() {
+        this->state = this->state * 6364136223846793005u + 1442695040888963407u;
+        return this->state >> 33;
+    }
+
+    std::string word() {
+        static const char *const words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot",
+                                            "golf", "hotel", "india", "juliett", "kilo", "lima"};
+        return words[this->next() % 12];
+    }
+
+private:
+    std::uint64_t state = 42;
+};
+
+/* an object of mixed keys and values, like a configuration file */
+static std::string small_file(generator &g) {
+    std::string s = "{\"name\":\"bench\",\"version\":3,\"enabled\":true,\"ratio\":0.75,\"owner\":null,\"servers\":[";
+    for (int i = 0; i < 16; ++i) {
+        if (i)
+            s += ',';
+        s += "{\"host\":\"" + g.word() + std::to_string(i) + ".example.com\",\"port\":" + std::to_string(8000 + g.next() % 1000) +
+             ",\"weight\":" + std::to_string(g.next() % 100) + ".5,\"tags\":[\"" + g.word() + "\",\"" + g.word() + "\"]}";
+    }
+    s += "],\"limits\":{\"cpu\":4,\"memory\":\"8G\",\"nested\":{\"a\":{\"b\":{\"c\":[1,2,3]}}}}}";
+    return s;
+}
+
+/* a list of records, one more key every few of them, until size bytes */
+static std::string records_file(generator &g, std::size_t size) {
+    std::string s = "[";
+    for (std::size_t i = 0; s.size() < size; ++i) {
+        if (i)
+            s += ',';
+        s += "{\"id\":" + std::to_string(i) + ",\"user\":\"" + g.word() + "_" + std::to_string(g.next() % 100000) +
+             "\",\"text\":\"the " + g.word() + " jumps over the " + g.word() + " and the " + g.word() +
+             "\",\"score\":" + std::to_string(g.next() % 10000) + "." + std::to_string(g.next() % 1000) +
+             ",\"verified\":" + (g.next() % 2 ? "true" : "false") + ",\"location\":[" + std::to_string(g.next() % 180) +
+             ".25,-" + std::to_string(g.next() % 90) + ".125]";
+        if (i % 4 == 0)
+            s += ",\"reply_to\":null";
+        s += '}';
+    }
+    s += ']';
+    return s;
+}
+
+static std::vector<corpus_file> generated_corpus() {
+    generator g;
+    std::vector<corpus_file> files;
+    files.push_back({"small", small_file(g)});
+    files.push_back({"medium", records_file(g, std::size_t(1) << 20)});
+    files.push_back({"huge", records_file(g, std::size_t(64) << 20)});
+    return files;
+}
+
+static std::string read_file(std::string const &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw json_exception{"cannot open " + path};
+    std::ostringstream s;
+    s << in.rdbuf();
+    return s.str();
+}
+
+/* Best time in seconds of f over runs repeated for about a quarter of
+   a second, at least three of them unless a single one takes longer. */
+template<typename F>
+static double best_time(F f) {
+    using clock = std::chrono::steady_clock;
+    double best = 1e300;
+    double total = 0;
+    for (int runs = 0; total < 0.25 || (runs < 3 && total < 2); ++runs) {
+        clock::time_point start = clock::now();
+        f();
+        double t = std::chrono::duration<double>(clock::now() - start).count();
+        best = std::min(best, t);
+        total += t;
+    }
+    return best;
+}
+
+static double mb_per_s(std::size_t bytes, double seconds) {
+    return static_cast<double>(bytes) / (1 << 20) / seconds;
+}
+
+/* Peak resident set of the process, in bytes, since the last call with
+   reset: resetting needs Linux's clear_refs, else the peak is left at
+   the highest of the whole run. */
+static std::size_t peak_rss(bool reset) {
+    if (reset) {
+        std::ofstream clear("/proc/self/clear_refs");
+        clear << "5";
+        return 0;
+    }
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+/* how many tokens the tokenizer finds in text */
+static std::size_t count_tokens(Tokenizer t) {
+    std::size_t n = 0;
+    while (t.get_token().type != TOKEN::FINE_INPUT)
+        ++n;
+    return n;
+}
+
+/* The tokenizer json.cpp started from, as it was then, reading one
+   character at a time from a stream: the baseline of --compare. Only
+   its debug output is left out. */
+namespace baseline {
+
+enum class TOKEN {
+    GRAFFA_APERTA = '{',
+    GRAFFA_CHIUSA = '}',
+    DUE_PUNTI = ':',
+    STRING = 's',
+    NUMBER = 'n',
+    QUADRA_APERTA = '[',
+    QUADRA_CHIUSA = ']',
+    VIRGOLA = ',',
+    BOOLEAN = 'b',
+    NULLO = '0',
+    FINE_INPUT = 'f',
+};
+
+struct Token {
+    std::string value;
+    TOKEN type;
+};
+
+class Tokenizer {
+public:
+    std::istream &is;
+    char curr_char = ' ';
+
+    Tokenizer(std::istream &input) : is(input) {}
+
+    void getWithoutWhiteSpace();
+
+    Token get_token();
+};
+
+void Tokenizer::getWithoutWhiteSpace() {
+    while ((curr_char == ' ' || curr_char == '\n') && is >> curr_char) {
+    }
+}
+
+Token Tokenizer::get_token() {
+    struct Token token;
+    if (!(is >> curr_char)) {
+        token.type = TOKEN::FINE_INPUT;
+        return token;
+    }
+
+    if (curr_char == ' ' || curr_char == '\n')
+        getWithoutWhiteSpace();
+
+    if (curr_char == '"') {
+        token.type = TOKEN::STRING;
+        token.value = "";
+
+        is.get(curr_char);
+
+        while (curr_char != '"') {
+            token.value += curr_char;
+
+            is.get(curr_char);
+        }
+    } else if (curr_char == '{') {
+        token.type = TOKEN::GRAFFA_APERTA;
+    } else if (curr_char == '}') {
+        token.type = TOKEN::GRAFFA_CHIUSA;
+    } else if (curr_char == '-' || (curr_char >= '0' && curr_char <= '9')) {
+        token.type = TOKEN::NUMBER;
+        token.value = "";
+        token.value += curr_char;
+        while ((curr_char == '-') || (curr_char >= '0' && curr_char <= '9') || curr_char == '.') {
+            curr_char = is.peek();
+
+            if (!is.peek()) {
+                break;
+            } else {
+                if ((curr_char == '-') || (curr_char >= '0' && curr_char <= '9') || (curr_char == '.')) {
+                    token.value += curr_char;
+                    is.get(curr_char);
+                }
+            }
+        }
+    } else if (curr_char == 'f') {
+        token.type = TOKEN::BOOLEAN;
+        token.value = "False";
+        char buffer[5];
+
+        is.get(buffer, 5);
+
+        std::string data(buffer);
+        if (data != "alse") {
+            throw json_exception{"boolean not valid"};
+        }
+    } else if (curr_char == 't') {
+        token.type = TOKEN::BOOLEAN;
+        token.value = "True";
+        char buffer[5];
+
+        is.get(buffer, 4);
+
+        std::string data(buffer);
+        if (data != "rue") {
+            throw json_exception{"boolean not valid"};
+        }
+    } else if (curr_char == 'n') {
+        token.type = TOKEN::NULLO;
+        is.seekg(3, std::ios_base::cur);
+    } else if (curr_char == '[') {
+        token.type = TOKEN::QUADRA_APERTA;
+    } else if (curr_char == ']') {
+        token.type = TOKEN::QUADRA_CHIUSA;
+    } else if (curr_char == ':') {
+        token.type = TOKEN::DUE_PUNTI;
+    } else if (curr_char == ',') {
+        token.type = TOKEN::VIRGOLA;
+    } else {
+        throw json_exception{"carattere non identificato: " + std::string(1, curr_char)};
+    }
+    return token;
+}
+
+/* how many tokens it finds in text */
+static std::size_t count_tokens(std::string_view text) {
+    std::istringstream in{std::string(text)};
+    Tokenizer t(in);
+    std::size_t n = 0;
+    while (t.get_token().type != TOKEN::FINE_INPUT)
+        ++n;
+    return n;
+}
+
+}  // namespace baseline
+
+static void run(corpus_file const &f) {
+    std::string_view text = f.text;
+
+    peak_rss(true);
+    std::size_t base_rss = peak_rss(false);
+    std::size_t allocs = allocations.load();
+    std::size_t bytes = allocated_bytes.load();
+    json tree = json::parse(text);
+    allocs = allocations.load() - allocs;
+    bytes = allocated_bytes.load() - bytes;
+    std::size_t rss = peak_rss(false) - std::min(base_rss, peak_rss(false));
+
+    double parse = best_time([&] { json j = json::parse(text); });
+    double validate = best_time([&] { json::validate(text); });
+    json::document doc;
+    double document = best_time([&] { doc.parse_borrowed(text); });
+    std::size_t out_size = tree.dump().size();
+    double dump = best_time([&] { std::string s = tree.dump(); });
+
+    std::printf("%-16s %10.2f %10.1f %10.1f %10.1f %10.1f %10.2f %12zu %12.2f\n", f.name.c_str(), text.size() / 1048576.0,
+                mb_per_s(text.size(), parse), mb_per_s(text.size(), document), mb_per_s(text.size(), validate),
+                mb_per_s(out_size, dump),
+                rss / 1048576.0, allocs, bytes / 1048576.0);
+}
+
+static void compare(corpus_file const &f) {
+    std::string_view text = f.text;
+    std::size_t tokens = count_tokens(Tokenizer(text));
+    double original = best_time([&] { baseline::count_tokens(text); });
+    double plain = best_time([&] { count_tokens(Tokenizer(text)); });
+    double indexed = 0;
+    if (text.size() <= UINT32_MAX) {
+        indexed = best_time([&] {
+            vector<uint32_t> index = build_structural_index(text);
+            count_tokens(Tokenizer(text, index));
+        });
+    }
+    double stream = best_time([&] {
+        std::istringstream in{std::string(text)};
+        json j;
+        in >> j;
+    });
+    std::printf("%-16s %12zu %12.1f %12.1f %12.1f %12.1f\n", f.name.c_str(), tokens, mb_per_s(text.size(), original),
+                mb_per_s(text.size(), plain), indexed ? mb_per_s(text.size(), indexed) : 0.0, mb_per_s(text.size(), stream));
+}
+
+int main(int argc, char **argv) {
+    bool comparing = false;
+    std::vector<corpus_file> files;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--compare")
+                comparing = true;
+            else
+                files.push_back({arg.substr(arg.find_last_of('/') + 1), read_file(arg)});
+        }
+        if (files.empty())
+            files = generated_corpus();
+
+        std::printf("%-16s %10s %10s %10s %10s %10s %10s %12s %12s\n", "file", "MB", "parse", "document", "validate",
+                    "dump", "peak MB", "allocs", "alloc MB");
+        for (corpus_file const &f : files)
+            run(f);
+
+        if (comparing) {
+            std::printf("\n%-16s %12s %12s %12s %12s %12s\n", "file", "tokens", "baseline", "tokenizer", "indexed",
+                        "stream parse");
+            for (corpus_file const &f : files)
+                compare(f);
+        }
+    } catch (json_exception const &e) {
+        std::fprintf(stderr, "%s\n", e.msg.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -1,1803 +1,6373 @@
-#include "json.hpp"
-
-
-template<typename Val>
-class list {
-    /* private struct node holding the values in the list */
-    struct node {
-        Val val;
-        node *next;
-    };
-
-public:
-
-    /* default constructor */
-    list();
-
-    /* constructor with one value v */
-    list(Val v);
-
-    /* copy constructor */
-    list(list<Val> const &rhs);
-
-    /* move constructor */
-    list(list<Val> &&rhs);
-
-    /* destructor */
-    ~list();
-
-    /* removes all the elements */
-    void clear();
-
-    /* return a const* to first node */
-    node const *cfront() const;
-
-    /* return a const* to last node */
-    node const *cback() const;
-
-    node *front() const;
-
-    node *back() const;
-
-    /* push to the front of the list a new element with value v */
-    void push_front(Val v);
-
-    /* push to the back of the list a new element with value v */
-    void push_back(Val v);
-
-    /* remove first element */
-    void pop_front();
-
-    /* remove last element */
-    void pop_back();
-
-    /* is the container empty? */
-    bool empty() const;
-
-    /* copy assignment operator:
-    l1 = l2 overwrites the content of
-    l1 with the content of l2, does not modify l2.
-    At the end, returns a reference to l1. */
-    list<Val> &operator=(list<Val> const &rhs);
-
-    /* move assignment operator:
-    l1 = l2 moves the content of
-    l2 into l1.
-    At the end, returns a reference to l1. */
-    list<Val> &operator=(list<Val> &&rhs);
-
-    /* is this container equal to rhs? */
-    bool operator==(list<Val> const &rhs) const;
-
-    /* is this container not equal to rhs? */
-    bool operator!=(list<Val> const &rhs) const;
-
-    /* Append to the back of the container the rhs
-    and return a reference to *this.
-    Why do we return a reference?
-    Because we may want to write: l1 += l2 += l3; */
-    list<Val> &operator+=(list<Val> const &rhs);
-
-    /* appends v at the back of the container
-    and return a reference to *this */
-    list<Val> &operator+=(Val v);
-
-    /* returns a const reference to the val of the i-th node if it exists */
-    Val const &operator[](uint64_t i) const;
-
-    /* returns a reference to the val of the i-th node if it exists */
-    Val &operator[](uint64_t i);
-
-    /* prefix decrement: remove head and return a reference to *this */
-    list<Val> &operator--();
-
-    /* postfix decrement: remove tail and return a reference to *this
-       Note: the int parameter is a dummy parameter used to differentiate
-       between prefix and postfix decrement. */
-    list<Val> &operator--(int dummy);
-
-    /* forward iterator */
-    struct iterator {
-        /* properties */
-        using iterator_category = std::forward_iterator_tag;
-        using value_type = Val;
-        using pointer = Val *;
-        using reference = Val &;
-
-        /* constructor */
-        iterator(node *ptr);
-
-        /* we let the compiler define the destructor
-           and copy constructor/assignment */
-
-        reference operator*() const;
-
-        /* Useful if Val is a struct with attributes.
-           For example, if Val has an attribute x, we
-           can write it->x.  */
-        pointer operator->() const;
-
-        /* prefix increment: advance the iterator to the next element
-           and return it. */
-        iterator &operator++();
-
-        /* postfix increment: copy the iterator, advance the
-           iterator to the next element, and return the copy. */
-        iterator operator++(int /* dummy */);
-
-        bool operator==(iterator const &rhs) const;
-
-        bool operator!=(iterator const &rhs) const;
-
-        operator bool() const;
-
-    private:
-        node *m_ptr;
-    };
-
-    using iterator = iterator;
-
-    /* forward const_iterator */
-    struct const_iterator {
-        using iterator_category = std::forward_iterator_tag;
-        using value_type = const Val;
-        using pointer = Val const *;
-        using reference = Val const &;
-
-        const_iterator(node *ptr);
-
-        reference operator*() const;
-
-        pointer operator->() const;
-
-        const_iterator &operator++();
-
-        const_iterator operator++(int /* dummy */);
-
-        bool operator==(const_iterator const &rhs) const;
-
-        bool operator!=(const_iterator const &rhs) const;
-
-        operator bool() const;
-
-    private:
-        node const *m_ptr;
-    };
-
-    using const_iterator = const_iterator;
-    /* return a new iterator pointing to the first element in the
-       container -- the "beginning" of the container */
-    // iterator begin();
-    iterator begin();
-
-    /* return a new iterator pointing to (one-past) the last element in the
-       container -- the "end" of the container */
-    iterator end();
-
-
-    const_iterator cbegin() const;
-
-    const_iterator cend() const;
-
-private:
-    node *m_front;  // pointer to first node: the "front" of the container
-    node *m_back;   // pointer to last node: the "back" of the container
-};
-
-
-/* default constructor */
-template<typename Val>
-list<Val>::list() : m_front(nullptr), m_back(nullptr) {}
-
-/* constructor with one value v */
-template<typename Val>
-list<Val>::list(Val v)
-        : list()  // calls the default constructor
-{
-    push_front(v);
-}
-
-/* copy constructor */
-template<typename Val>
-list<Val>::list(list<Val> const &rhs)
-        : list()  // calls the default constructor
-{
-    auto ptr = rhs.front();
-    while (ptr) {
-        push_back(ptr->val);
-        ptr = ptr->next;
-    }
-    /* can also be re-written in terms of copy assignment operator,
-    very elegantly, like this: */
-    // *this = rhs;
-}
-
-/* copy assignment operator */
-template<typename Val>
-list<Val> &list<Val>::operator=(list<Val> const &rhs) {
-    if (this != &rhs) {  // not a self-assignment
-        /* first delete all items (and free the memory) */
-        clear();
-        auto ptr = rhs.front();
-        while (ptr) {
-            push_back(ptr->val);
-            ptr = ptr->next;
-        }
-    }
-    return *this;
-}
-
-/* move constructor */
-template<typename Val>
-list<Val>::list(list<Val> &&rhs)
-        : list()  // calls the default constructor
-{
-    m_front = rhs.m_front;
-    m_back = rhs.m_back;
-    rhs.m_front = nullptr;
-    rhs.m_back = nullptr;
-    /* can also be re-written in terms of move assignment operator,
-    very elegantly, like this: */
-    // *this = std::move(rhs);
-}
-
-/* move assignment operator */
-template<typename Val>
-list<Val> &list<Val>::operator=(list<Val> &&rhs) {
-    if (this != &rhs) {  // not a self-assignment
-        /* first delete all items (and free the memory) */
-        clear();
-        m_front = rhs.m_front;
-        m_back = rhs.m_back;
-        rhs.m_front = nullptr;
-        rhs.m_back = nullptr;
-    }
-    return *this;
-}
-
-/* is the container empty? */
-template<typename Val>
-bool list<Val>::empty() const {
-    return m_front == nullptr;
-}
-
-/* remove first element */
-template<typename Val>
-void list<Val>::pop_front() {
-    if (!empty()) {
-        node *tmp = m_front;
-        m_front = m_front->next;
-        delete tmp;
-        if (empty()) m_back = nullptr;
-    }
-}
-
-/* remove last element */
-template<typename Val>
-void list<Val>::pop_back() {
-    if (m_front == m_back) {
-        pop_front();
-        return;
-    }
-    /* we have at least 2 nodes in the list */
-    /* take the pointer to the node just before m_back */
-    node *prev = m_front;
-    while (prev->next != m_back) prev = prev->next;
-    /* delete m_back */
-    delete m_back;
-    /* adjust m_back */
-    prev->next = nullptr;
-    m_back = prev;
-}
-
-/* clear() */
-template<typename Val>
-void list<Val>::clear() {
-    while (!empty()) pop_front();
-}
-
-/* destructor */
-template<typename Val>
-list<Val>::~list() {
-    clear();
-}
-
-/* return a const* to first node */
-template<typename Val>
-typename list<Val>::node const *list<Val>::cfront() const {
-    return m_front;
-}
-
-/* return a const* to last node */
-template<typename Val>
-typename list<Val>::node const *list<Val>::cback() const {
-    return m_back;
-}
-
-template<typename Val>
-typename list<Val>::node *list<Val>::front() const {
-    return m_front;
-}
-
-template<typename Val>
-typename list<Val>::node *list<Val>::back() const {
-    return m_back;
-}
-
-/* push to the front of the list a new element with value v */
-template<typename Val>
-void list<Val>::push_front(Val v) {
-    if (empty()) {
-        m_front = new node{v, nullptr};
-        m_back = m_front;
-        return;
-    }
-    m_front = new node{v, m_front};
-}
-
-/* push to the back of the list a new element with value v */
-template<typename Val>
-void list<Val>::push_back(Val v) {
-    if (empty()) {
-        push_front(v);
-        return;
-    }
-    m_back->next = new node{v, nullptr};
-    m_back = m_back->next;
-}
-
-/* prefix decrement: remove the first node and return a reference to *this */
-template<typename Val>
-list<Val> &list<Val>::operator--() {
-    pop_front();
-    return *this;
-}
-
-/* postfix decrement: remove the last node and return a reference to *this
-   Note:
-   the int parameter is a dummy parameter used to differentiate between
-   prefix and postfix decrement. */
-template<typename Val>
-list<Val> &list<Val>::operator--(int /* dummy */) {
-    pop_back();
-    return *this;
-}
-
-/* is this container equal to rhs? */
-template<typename Val>
-bool list<Val>::operator==(list<Val> const &rhs) const {
-
-    auto it1 = begin();
-    auto it2 = rhs.begin();
-    while (it1 or it2) {
-        if ((!it1 and it2) or (it1 and !it2) or (*it1 != *it2)) {
-            return false;
-        }
-        it1++;
-        it2++;
-    }
-    return true;
-}
-
-/* is this container not equal to rhs? */
-template<typename Val>
-bool list<Val>::operator!=(list<Val> const &rhs) const {
-    return !((*this) == rhs);
-}
-
-/* append to the back of the container the rhs
-and return a reference to *this */
-template<typename Val>
-list<Val> &list<Val>::operator+=(list<Val> const &rhs) {
-    node const *ptr = rhs.front();
-    while (ptr) {
-        push_back(ptr->val);
-        ptr = ptr->next;
-    }
-    return *this;
-}
-
-/* push v to the back of the container
-and return a reference to *this */
-template<typename Val>
-list<Val> &list<Val>::operator+=(Val v) {
-    push_back(v);
-    return *this;
-}
-
-/* returns a const reference to the val of the i-th node if it exists */
-template<typename Val>
-Val const &list<Val>::operator[](uint64_t i) const {
-    uint64_t pos = 0;
-    node const *ptr = m_front;
-    while (pos++ < i) ptr = ptr->next;
-    return ptr->val;
-}
-
-/* returns a reference to the val of the i-th node if it exists */
-template<typename Val>
-Val &list<Val>::operator[](uint64_t i) {
-    uint64_t pos = 0;
-    node const *ptr = m_front;
-    while (pos++ < i) ptr = ptr->next;
-    return ptr->val;
-}
-
-/*
-    iterator implementation
-*/
-
-template<typename Val>
-list<Val>::iterator::iterator(node *ptr) : m_ptr(ptr) {}
-
-template<typename Val>
-typename list<Val>::iterator::reference list<Val>::iterator::operator*() const {
-    return m_ptr->val;
-}
-
-template<typename Val>
-typename list<Val>::iterator::pointer list<Val>::iterator::operator->() const {
-    return &(m_ptr->val);
-}
-
-template<typename Val>
-typename list<Val>::iterator &list<Val>::iterator::operator++() {
-    m_ptr = m_ptr->next;
-    return *this;
-}
-
-template<typename Val>
-typename list<Val>::iterator list<Val>::iterator::operator++(int /* dummy */) {
-    iterator copy = *this;
-    m_ptr = m_ptr->next;
-    return copy;
-}
-
-template<typename Val>
-bool list<Val>::iterator::operator==(
-        typename list<Val>::iterator const &rhs) const {
-    return m_ptr == rhs.m_ptr;
-}
-
-template<typename Val>
-bool list<Val>::iterator::operator!=(
-        typename list<Val>::iterator const &rhs) const {
-    return !(*this == rhs);
-}
-
-template<typename Val>
-list<Val>::iterator::operator bool() const {
-    return m_ptr != nullptr;  // or just: return m_ptr
-}
-
-template<typename Val>
-typename list<Val>::iterator list<Val>::begin() {
-    return {m_front};
-}
-
-template<typename Val>
-typename list<Val>::iterator list<Val>::end() {
-    /* note: we do not return {m_back} because
-       this will be an iterator pointing to the last element.
-       We return an iterator pointing to one-past the last element,
-       thus, iterator(nullptr). */
-    return {nullptr};
-}
-
-/*
-    const_iterator implementation
-*/
-
-template<typename Val>
-list<Val>::const_iterator::const_iterator(node *ptr) : m_ptr(ptr) {}
-
-template<typename Val>
-typename list<Val>::const_iterator::reference
-list<Val>::const_iterator::operator*() const {
-    return m_ptr->val;
-}
-
-template<typename Val>
-typename list<Val>::const_iterator::pointer
-list<Val>::const_iterator::operator->() const {
-    return &(m_ptr->val);
-}
-
-template<typename Val>
-typename list<Val>::const_iterator &list<Val>::const_iterator::operator++() {
-    m_ptr = m_ptr->next;
-    return *this;
-}
-
-template<typename Val>
-typename list<Val>::const_iterator list<Val>::const_iterator::operator++(
-        int /* dummy */) {
-    const_iterator copy = *this;
-    m_ptr = m_ptr->next;
-    return copy;
-}
-
-template<typename Val>
-bool list<Val>::const_iterator::operator==(
-        typename list<Val>::const_iterator const &rhs) const {
-    return m_ptr == rhs.m_ptr;
-}
-
-template<typename Val>
-bool list<Val>::const_iterator::operator!=(
-        typename list<Val>::const_iterator const &rhs) const {
-    return !(*this == rhs);
-}
-
-template<typename Val>
-list<Val>::const_iterator::operator bool() const {
-    return m_ptr != nullptr;  // or just: return m_ptr
-}
-
-template<typename Val>
-typename list<Val>::const_iterator list<Val>::cbegin() const {
-    return {m_front};
-}
-
-template<typename Val>
-typename list<Val>::const_iterator list<Val>::cend() const {
-    /* note: we do not return {m_back} because
-       this will be an iterator pointing to the last element.
-       We return an iterator pointing to one-past the last element,
-       thus, iterator(nullptr). */
-    return {nullptr};
-}
-
-/*
-    Non member functions.
-*/
-
-/* return lhs+rhs where both lhs and rhs are lists */
-template<typename Val>
-list<Val> operator+(list<Val> const &lhs, list<Val> const &rhs) {
-    list<Val> result = lhs;  // copy constructor
-    result += rhs;
-    return result;
-}
-
-/* return lhs+rhs where rhs is a value */
-template<typename Val>
-list<Val> operator+(list<Val> const &lhs, Val rhs) {
-    list<Val> res{lhs};
-    res.push_back(rhs);
-    return res;
-}
-
-/* return lhs+rhs where lhs is a value */
-template<typename Val>
-list<Val> operator+(Val lhs, list<Val> const &rhs) {
-    list<Val> res{rhs};
-    res.push_front(lhs);
-    return res;
-}
-
-template<typename Val>
-std::ostream &operator<<(std::ostream &os, list<Val> const &list) {
-    for (auto ptr = list.front(); ptr; ptr = ptr->next) {
-        os << ptr->val;
-        if (ptr->next) os << " -> ";
-    }
-    return os;
-}
-
-template<typename Val>
-std::istream &operator>>(std::istream &is, list <Val> &list) {
-    Val v;
-    while (is >> v) list.push_back(v);
-    return is;
-}
-
-template<typename Val>
-void read_list(list<Val> &list) {
-    uint64_t list_size = 0;
-    Val v;
-    std::cin >> list_size;                       // first read list_size
-    for (uint64_t i = 0; i != list_size; ++i) {  // then value by value
-        std::cin >> v;
-        list.push_back(v);
-    }
-}
-
-struct json::impl {
-    double *number = nullptr;
-    bool *b = nullptr;
-    std::string *s = nullptr;
-    list<json> *l = nullptr;
-    list<std::pair<std::string, json>> *dict = nullptr;
-
-    void clear() {
-        if (number != nullptr)
-            delete number;
-        else if (b != nullptr)
-            delete b;
-        else if (s != nullptr)
-            delete s;
-        else if (l != nullptr)
-            delete l;
-        else if (dict != nullptr)
-            delete dict;
-    }
-
-};
-
-bool json::is_list() const {
-    return this->pimpl->l != nullptr;
-}
-
-bool json::is_dictionary() const {
-    return this->pimpl->dict != nullptr;
-}
-
-bool json::is_string() const {
-    return this->pimpl->s != nullptr;
-}
-
-bool json::is_number() const {
-    return this->pimpl->number != nullptr;
-}
-
-bool json::is_bool() const {
-    return this->pimpl->b != nullptr;
-}
-
-bool json::is_null() const {
-    return !this->is_list() && !this->is_dictionary() && !this->is_string() && !this->is_number() && !this->is_bool();
-}
-
-struct json::list_iterator {
-    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
-    using value_type = list<json>::iterator::value_type;
-    using pointer = list<json>::iterator::pointer;
-    using reference = list<json>::iterator::reference;
-
-    /* constructor */
-    list_iterator(list<json>::iterator _it) : it(_it) {}
-
-    /* we let the compiler define the destructor
-       and copy constructor/assignment */
-
-    reference operator*() const {
-        return *this->it;
-    }
-
-    /* ritorna puntatore all'elemento corrente della lista  */
-    pointer operator->() const {
-        return &(*this->it);
-    }
-
-    /* prefix increment: advance the iterator to the next element
-       and return it. */
-    list_iterator &operator++() {
-        ++(this->it);
-        return *this;
-    }
-
-    /* postfix increment: copy the iterator, advance the
-       iterator to the next element, and return the copy. */
-    list_iterator operator++(int /* dummy */) {
-        list_iterator copy = *this;
-        this->it = ++(this->it);
-        return copy;
-    }
-
-    bool operator==(list_iterator const &rhs) const {
-        return this->it == rhs.it;
-    }
-
-
-    bool operator!=(list_iterator const &rhs) const {
-        return !(this->it == rhs.it);
-    }
-
-private:
-    list<json>::iterator it;
-};
-
-
-struct json::const_list_iterator {
-    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
-    using value_type = list<json>::const_iterator::value_type;
-    using const_pointer = list<json>::const_iterator::pointer;
-    using const_reference = list<json>::const_iterator::reference;
-
-    /* constructor */
-    const_list_iterator(const list<json>::const_iterator _it) : it(_it) {}
-
-    /* we let the compiler define the destructor
-       and copy constructor/assignment */
-
-    const_reference operator*() const {
-        return *this->it;
-    }
-
-    /* ritorna puntatore all'elemento corrente della lista  */
-    const_pointer operator->() const {
-        return &(*this->it);
-    }
-
-    /* prefix increment: advance the iterator to the next element
-       and return it. */
-    const_list_iterator &operator++() {
-        ++(this->it);
-        return *this;
-    }
-
-    /* postfix increment: copy the iterator, advance the
-       iterator to the next element, and return the copy. */
-    const_list_iterator operator++(int /* dummy */) {
-        const_list_iterator copy = *this;
-        this->it = ++(this->it);
-        return copy;
-    }
-
-    bool operator==(const_list_iterator const &rhs) const {
-        return this->it == rhs.it;
-    }
-
-
-    bool operator!=(const_list_iterator const &rhs) const {
-        return !(*this == rhs); //!(this->it == rhs.it);
-    }
-
-private:
-    list<json>::const_iterator it;
-};
-
-
-struct json::dictionary_iterator {
-    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
-    using value_type = list<std::pair<std::string, json>>::iterator::value_type;
-    using pointer = list<std::pair<std::string, json>>::iterator::pointer;
-    using reference = list<std::pair<std::string, json>>::iterator::reference;
-
-    /* constructor */
-    dictionary_iterator(const list<std::pair<std::string, json>>::iterator _it) : it(_it) {}
-
-    /* we let the compiler define the destructor
-       and copy constructor/assignment */
-
-    reference operator*() const {
-        return *this->it;
-    }
-
-    /* ritorna puntatore all'elemento corrente della lista  */
-    pointer operator->() const {
-        return &(*this->it);
-    }
-
-    /* prefix increment: advance the iterator to the next element
-       and return it. */
-    dictionary_iterator &operator++() {
-        ++(this->it);
-        return *this;
-    }
-
-    /* postfix increment: copy the iterator, advance the
-       iterator to the next element, and return the copy. */
-    dictionary_iterator operator++(int /* dummy */) {
-        dictionary_iterator copy = *this;
-        this->it = ++(this->it);
-        return copy;
-    }
-
-    bool operator==(dictionary_iterator const &rhs) const {
-        return this->it == rhs.it;
-    }
-
-
-    bool operator!=(dictionary_iterator const &rhs) const {
-        return !(this->it == rhs.it);
-    }
-
-private:
-    list<std::pair<std::string, json>>::iterator it;
-};
-
-
-struct json::const_dictionary_iterator {
-    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
-    using value_type = list<std::pair<std::string, json>>::const_iterator::value_type;
-    using const_pointer = list<std::pair<std::string, json>>::const_iterator::pointer;
-    using const_reference = list<std::pair<std::string, json>>::const_iterator::reference;
-
-    /* constructor */
-    const_dictionary_iterator(list<std::pair<std::string, json>>::const_iterator _it) : it(_it) {}
-
-    /* we let the compiler define the destructor
-       and copy constructor/assignment */
-
-    const_reference operator*() const {
-        return *this->it;
-    }
-
-    /* ritorna puntatore all'elemento corrente della lista  */
-    const_pointer operator->() const {
-        return &(*this->it);
-    }
-
-    /* prefix increment: advance the iterator to the next element
-       and return it. */
-    const_dictionary_iterator &operator++() {
-        ++(this->it);
-        return *this;
-    }
-
-    /* postfix increment: copy the iterator, advance the
-       iterator to the next element, and return the copy. */
-    const_dictionary_iterator operator++(int /* dummy */) {
-        const_dictionary_iterator copy = *this;
-        this->it = ++(this->it);
-        return copy;
-    }
-
-    bool operator==(const_dictionary_iterator const &rhs) const {
-        return this->it == rhs.it;
-    }
-
-
-    bool operator!=(const_dictionary_iterator const &rhs) const {
-        return !(*this == rhs); //!(this->it == rhs.it);
-    }
-
-private:
-    list<std::pair<std::string, json>>::const_iterator it;
-};
-
-
-json::list_iterator json::begin_list() {
-    if (!this->is_list()) {
-        std::cout << "riga 877" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return list_iterator(this->pimpl->l->begin());
-    }
-}
-
-json::list_iterator json::end_list() {
-    if (!this->is_list()) {
-        std::cout << "riga 887" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return list_iterator(this->pimpl->l->end());
-    }
-}
-
-json::const_list_iterator json::begin_list() const {
-    if (!this->is_list()) {
-        std::cout << "riga 897" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return const_list_iterator(this->pimpl->l->cbegin());
-    }
-}
-
-json::const_list_iterator json::end_list() const {
-    if (!this->is_list()) {
-        std::cout << "riga 907" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return const_list_iterator(this->pimpl->l->cend());
-    }
-}
-
-
-json::dictionary_iterator json::begin_dictionary() {
-    if (!this->is_list()) {
-        std::cout << "riga 918" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return dictionary_iterator(this->pimpl->dict->begin());
-    }
-}
-
-json::dictionary_iterator json::end_dictionary() {
-    if (!this->is_list()) {
-        std::cout << "riga 928" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-    else {
-        return dictionary_iterator(this->pimpl->dict->end());
-    }
-}
-
-json::const_dictionary_iterator json::begin_dictionary() const {
-    if (!this->is_dictionary()) {
-        std::cout << "riga 938" << std::endl;
-        throw json_exception{"this is not a dictionary"};
-    }
-    else {
-        return const_dictionary_iterator(this->pimpl->dict->cbegin());
-    }
-}
-
-json::const_dictionary_iterator json::end_dictionary() const {
-    if (!this->is_dictionary()) {
-        std::cout << "riga 948" << std::endl;
-        throw json_exception{"this is not a dictionary"};
-    }
-    else {
-        return const_dictionary_iterator(this->pimpl->dict->cend());
-    }
-}
-
-
-
-json const &json::operator[](std::string const &kiave) const {
-    if (!this->is_dictionary()){
-        std::cout << "riga 969" << std::endl;
-        throw json_exception{"this is not a dictionary"};
-    }
-
-
-    for (json::dictionary_iterator it = this->pimpl->dict->begin(); it != this->pimpl->dict->end(); it++) {
-        if ((*it).first == kiave)
-            return (*it).second;
-    }
-    std::cout << "riga 978" << std::endl;
-    throw json_exception{"non posso effettuare l'inserimento"};
-}
-
-json &json::operator[](std::string const &kiave) {
-    if (!this->is_dictionary()) {
-        std::cout << "riga 984" << std::endl;
-        throw json_exception{"this is not a dictionary"};
-    }
-
-
-    for (json::dictionary_iterator it = this->pimpl->dict->begin(); it != this->pimpl->dict->end(); it++) {
-        if ((*it).first == kiave)
-            return (*it).second;
-    }
-    this->pimpl->dict->push_back(std::pair<std::string, json>(kiave, json()));
-    return this->pimpl->dict->back()->val.second;
-
-}
-
-json::json() : pimpl(new json::impl) {}
-
-json::~json() {
-    if (this->is_bool())
-        delete this->pimpl->b;
-    if (this->is_number())
-        delete this->pimpl->number;
-    if (this->is_string())
-        delete this->pimpl->s;
-    if (this->is_dictionary())
-        delete this->pimpl->dict;
-    if (this->is_list())
-        delete this->pimpl->l;
-
-    delete this->pimpl;
-}
-
-json::json(json const &j) : json() {
-    if (j.is_bool())
-        this->pimpl->b = new bool(*j.pimpl->b);
-    if (j.is_number())
-        this->pimpl->number = new double(*j.pimpl->number);
-    if (j.is_string())
-        this->pimpl->s = new std::string(*j.pimpl->s);
-    if (j.is_dictionary()) {
-        this->pimpl->dict = new list<std::pair<std::string, json>>(*j.pimpl->dict);
-    }
-    if (j.is_list()) {
-        this->pimpl->l = new list<json>(*j.pimpl->l);
-    }
-}
-
-json::json(json &&j) : json() {
-    if (j.is_bool()) {
-        this->pimpl->b = j.pimpl->b;
-        j.pimpl->b = nullptr;
-    }
-    if (j.is_number()) {
-        this->pimpl->number = j.pimpl->number;
-        j.pimpl->number = nullptr;
-    }
-    if (j.is_string()) {
-        this->pimpl->s = j.pimpl->s;
-        j.pimpl->s = nullptr;
-    }
-    if (j.is_dictionary()) {
-        this->pimpl->dict = j.pimpl->dict;
-        j.pimpl->dict = nullptr;
-    }
-    if (j.is_list()) {
-        this->pimpl->l = j.pimpl->l;
-        j.pimpl->l = nullptr;
-    }
-}
-
-json &json::operator=(json const &j) {
-    if (this != &j) {  // not a self-assignment
-        /* first delete all items (and free the memory) */
-        this->pimpl->clear();
-        if (j.is_bool())
-            this->pimpl->b = new bool(*j.pimpl->b);
-        if (j.is_number())
-            this->pimpl->number = new double(*j.pimpl->number);
-        if (j.is_string())
-            this->pimpl->s = new std::string(*j.pimpl->s);
-        if (j.is_dictionary()) {
-            this->pimpl->dict = new list<std::pair<std::string, json>>(*j.pimpl->dict);
-        }
-        if (j.is_list()) {
-            this->pimpl->l = new list<json>(*j.pimpl->l);
-        }
-    }
-    return *this;
-}
-
-
-json &json::operator=(json &&j) {
-    if (this != &j) {  // not a self-assignment
-        /* first delete all items (and free the memory) */
-        this->pimpl->clear();
-        if (j.is_bool()) {
-            this->pimpl->b = j.pimpl->b;
-            j.pimpl->b = nullptr;
-        }
-        if (j.is_number()) {
-            this->pimpl->number = j.pimpl->number;
-            j.pimpl->number = nullptr;
-        }
-        if (j.is_string()) {
-            this->pimpl->s = j.pimpl->s;
-            j.pimpl->s = nullptr;
-        }
-        if (j.is_dictionary()) {
-            this->pimpl->dict = j.pimpl->dict;
-            j.pimpl->dict = nullptr;
-        }
-        if (j.is_list()) {
-            this->pimpl->l = j.pimpl->l;
-            j.pimpl->l = nullptr;
-        }
-    }
-    return *this;
-}
-
-
-double &json::get_number() {
-    if (this->is_number())
-        return *(this->pimpl->number);
-    else {
-        std::cout << "riga 1107" << std::endl;
-        throw json_exception{"this is not a number"};
-    }
-}
-
-double const &json::get_number() const {
-    if (this->is_number())
-        return *(this->pimpl->number);
-    else {
-        std::cout << "riga 1116" << std::endl;
-        throw json_exception{"this is not a number"};
-    }
-}
-
-bool &json::get_bool() {
-    if (this->is_bool())
-        return *(this->pimpl->b);
-    else {
-        std::cout << "riga 1125" << std::endl;
-        throw json_exception{"this is not a bool"};
-    }
-}
-
-bool const &json::get_bool() const {
-    if (this->is_bool())
-        return *(this->pimpl->b);
-    else {
-        std::cout << "riga 1134" << std::endl;
-        throw json_exception{"this is not a bool"};
-    }
-}
-
-std::string &json::get_string() {
-    if (this->is_string())
-        return *(this->pimpl->s);
-    else {
-        std::cout << "riga 1143" << std::endl;
-        throw json_exception{"this is not a string"};
-    }
-}
-
-std::string const &json::get_string() const {
-    if (this->is_string())
-        return *(this->pimpl->s);
-    else {
-        std::cout << "riga 1152" << std::endl;
-        throw json_exception{"this is not a string"};
-    }
-}
-
-void json::set_string(const std::string &x) {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-
-    this->pimpl->s = new std::string{x};
-}
-
-void json::set_bool(bool x) {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-
-    this->pimpl->b = new bool{x};
-}
-
-void json::set_number(double x) {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-
-    this->pimpl->number = new double{x};
-}
-
-void json::set_null() {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-}
-
-void json::set_list() {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-
-    this->pimpl->l = new list<json>();
-}
-
-void json::set_dictionary() {
-    if (this->is_number())
-        delete this->pimpl->number;
-    else if (this->is_list())
-        delete this->pimpl->l;
-    else if (this->is_bool())
-        delete this->pimpl->b;
-    else if (this->is_dictionary())
-        delete this->pimpl->dict;
-    else if (this->is_string())
-        delete this->pimpl->s;
-
-    this->pimpl->dict = new list<std::pair<std::string, json>>();
-}
-
-void json::push_front(const json &x) {
-    if (this->is_list()) {
-        this->pimpl->l->push_front(x);
-    } else {
-        std::cout << "riga 1249" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-}
-
-void json::push_back(const json &x) {
-    if (this->is_list())
-        this->pimpl->l->push_back(x);
-    else {
-        std::cout << "riga 1258" << std::endl;
-        throw json_exception{"this is not a list"};
-    }
-}
-
-void json::insert(const std::pair<std::string, json> &x) {
-    if (this->is_dictionary()) {
-        this->pimpl->dict->push_front(x);
-    } else {
-        std::cout << "riga 1267" << std::endl;
-        throw json_exception{"this is not a dictionary"};
-    }
-}
-
-std::ostream &operator<<(std::ostream &lhs, json const &rhs) {
-    if (rhs.is_number()) {
-        lhs << rhs.get_number();
-    } else if (rhs.is_list()) {
-        lhs << "[ ";
-        for (json::const_list_iterator it = rhs.begin_list(); it != rhs.end_list(); it++) {
-            lhs << *it << ", ";
-        }
-        lhs << "] ";
-    } else if (rhs.is_dictionary()) {
-        lhs << "{ ";
-        for (json::const_dictionary_iterator it = rhs.begin_dictionary(); it != rhs.end_dictionary(); it++) {
-            lhs << (*it).first << ":" << (*it).second << ", ";
-        }
-        lhs << "} ";
-    } else if (rhs.is_string()) {
-        lhs << rhs.get_string();
-    } else if (rhs.is_bool()) {
-        lhs << (rhs.get_bool() ? "true" : "false");
-    } else {
-        lhs << "null";
-    }
-
-    return lhs;
-}
-
-
-
-
-
-enum class TOKEN
-{
-    GRAFFA_APERTA = '{',
-    GRAFFA_CHIUSA = '}',
-    DUE_PUNTI = ':',
-    STRING = 's',
-    NUMBER = 'n',
-    QUADRA_APERTA = '[',
-    QUADRA_CHIUSA = ']',
-    VIRGOLA = ',',
-    BOOLEAN = 'b',
-    NULLO = '0',
-    FINE_INPUT = 'f',
-};
-
-struct Token
-{
-    std::string value;
-    TOKEN type;
-    std::string toString();
-};
-
-
-class Tokenizer{
-public:
-    std::string s;
-    std::istream& is;
-    char curr_char = ' ';
-
-    Tokenizer(std::istream& input) : is(input) {}
-
-    //Tokenizer(std::string st) : s(st) {}
-
-
-    void getWithoutWhiteSpace();
-
-
-
-    Token get_token();
-
-
-};
-
-
-void Tokenizer::getWithoutWhiteSpace() {
-
-    while ((curr_char == ' ' || curr_char == '\n') && is >> curr_char) {
-
-
-    }
-
-}
-
-
-Token Tokenizer::get_token() {
-    struct Token token;
-    //char c = ' ';
-    //is.get(c);
-    //std::cout<< curr_char <<std::endl;
-    if(!(is >> curr_char)){
-        token.type = TOKEN::FINE_INPUT;
-        return token;
-    }
-
-    if(curr_char == ' ' || curr_char == '\n')
-        getWithoutWhiteSpace();
-
-
-    if (curr_char == '"') {
-        token.type = TOKEN::STRING;
-        token.value = "";
-
-        is.get(curr_char);
-
-        while (curr_char != '"') {
-
-            token.value += curr_char;
-
-            is.get(curr_char);
-        }
-    } else if (curr_char == '{') {
-        token.type = TOKEN::GRAFFA_APERTA;
-    } else if (curr_char == '}') {
-        token.type = TOKEN::GRAFFA_CHIUSA;
-    } else if (curr_char == '-' || (curr_char >= '0' && curr_char <= '9')) {
-        //Check if string is numeric
-        token.type = TOKEN::NUMBER;
-        token.value = "";
-        token.value += curr_char;
-        //std::streampos prevCharPos = is.tellg();
-        while ((curr_char == '-') || (curr_char >= '0' && curr_char <= '9') || curr_char == '.') {
-            //prevCharPos = is.tellg();
-            //is.get(c);
-            curr_char = is.peek();
-
-            if (!is.peek()) {
-                break;
-            } else {
-                if ((curr_char == '-') || (curr_char >= '0' && curr_char <= '9') || (curr_char == '.')) {
-                    token.value += curr_char;
-                    is.get(curr_char);
-                } else {
-                    //is.seekg(prevCharPos);
-                    // std::cout << c << std::endl;
-                }
-            }
-        }
-    } else if (curr_char == 'f') {
-        token.type = TOKEN::BOOLEAN;
-        token.value = "False";
-        char buffer[5];
-
-        is.get(buffer, 5);
-
-        std::string data(buffer);
-        if (data != "alse") {
-            throw json_exception{"boolean not valid"};
-        }
-    } else if (curr_char == 't') {
-        token.type = TOKEN::BOOLEAN;
-        token.value = "True";
-        char buffer[5];
-
-        is.get(buffer, 4);
-
-        std::string data(buffer);
-        if (data != "rue") {
-            throw json_exception{"boolean not valid"};
-        }
-
-
-    } else if (curr_char == 'n') {
-        token.type = TOKEN::NULLO;
-        is.seekg(3,std::ios_base::cur);
-    } else if (curr_char == '[') {
-        token.type = TOKEN::QUADRA_APERTA;
-    } else if (curr_char == ']') {
-        token.type = TOKEN::QUADRA_CHIUSA;
-    } else if (curr_char == ':') {
-        token.type = TOKEN::DUE_PUNTI;
-    } else if (curr_char == ',') {
-        token.type = TOKEN::VIRGOLA;
-    }
-    else{
-        std::cout << "riga 1381 " << curr_char << std::endl;
-        throw json_exception {&"carattere non identificato: "[ curr_char]};
-    }
-    return token;///se non è nessuna di queste cose ritorna lo stesso il token errato
-}
-
-
-json get_json_string(Token &t) {
-    json j = json();
-    j.set_string(t.value);
-    return j;
-}
-
-json get_json_number(Token& t){
-    json j = json();
-    //std::stoi(t.value);
-    j.set_number(std::stod(t.value));///converto la stringa/token t.value in numero?
-    return j;
-}
-
-json get_json_boolean(Token& t){
-    json j = json();
-    if(t.value == "True")
-        j.set_bool(true);
-    else
-        j.set_bool(false);
-
-    return j;
-}
-
-json get_json_null(Token& t){
-    json j = json();
-    j.set_null();
-    return j;
-}
-
-json get_json_list(Tokenizer& t);
-
-json get_json_dictionary(Tokenizer& t){
-    json j = json();
-    j.set_dictionary();
-    Token token = t.get_token();
-    std::string sinistra = "";
-    bool b = false;
-    bool primo = true;
-    bool virgola = false;
-    while(token.type != TOKEN::GRAFFA_CHIUSA){
-        if(token.type == TOKEN::STRING){
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_string(token)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_string(token)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1444" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1450" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-
-        }
-        else if(token.type == TOKEN::NUMBER){
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_number(token)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_number(token)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1471" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1477" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-        }
-        else if(token.type == TOKEN::BOOLEAN){
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_boolean(token)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_boolean(token)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1497" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1503" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-        }
-        else if(token.type == TOKEN::NULLO){
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_null(token)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_null(token)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1523" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1529" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-        }
-        else if(token.type == TOKEN::GRAFFA_APERTA){
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_dictionary(t)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_dictionary(t)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1549" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1555" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-        }
-        else if(token.type == TOKEN::QUADRA_APERTA){
-            //primo = true;
-            if(sinistra.empty() && !b){
-                sinistra = token.value;
-            }
-            else if(!sinistra.empty() && b){
-                if(primo && !virgola) {
-                    j.insert({sinistra, get_json_list(t)});
-                    b = false;
-                    primo = false;
-                }
-                else if(!primo && virgola){
-                    j.insert({sinistra, get_json_list(t)});
-                    b = false;
-                    virgola = false;
-                }
-                else{
-                    std::cout<< "riga 1575" <<std::endl;
-                    throw json_exception{"problema virgola"};
-                }
-
-            }
-            else{
-                std::cout << "riga 1581" << std::endl;
-                throw json_exception{"due punti mancanti"};
-            }
-        }
-        else if(token.type == TOKEN::DUE_PUNTI){
-            if(!sinistra.empty() && !b){
-                b = true;
-            }
-            else{
-                std::cout << "riga 1590" << std::endl;
-                throw json_exception{"formato json non valido"};
-            }
-        }
-        else if(token.type == TOKEN::VIRGOLA){
-            if(!virgola){
-                virgola = true;
-                b = false;
-                sinistra = "";
-            }
-            else{
-                std::cout << "riga 1599"<< std::endl;
-                throw json_exception{"hai ricevuto una virgola non necessaria"};
-            }
-
-        }
-        else{
-            std::cout << "riga 1605" << std::endl;
-            throw json_exception {"formato json non valido"};
-        }
-        token = t.get_token();
-    }
-    return j;
-}
-
-json get_json_list(Tokenizer& t){
-    json j = json();
-    j.set_list();
-    Token token = t.get_token();
-    bool virgola = false;
-    bool primo = true;
-    while(token.type != TOKEN::QUADRA_CHIUSA) {
-        if (token.type == TOKEN::STRING) {
-            if(primo && !virgola) {
-                j.push_back(get_json_string(token));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_string(token));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1630" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-        } else if (token.type == TOKEN::NUMBER) {
-            if(primo && !virgola) {
-                j.push_back(get_json_number(token));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_number(token));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1643" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-        } else if (token.type == TOKEN::BOOLEAN) {
-            if(primo && !virgola) {
-                j.push_back(get_json_boolean(token));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_boolean(token));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1656" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-        } else if (token.type == TOKEN::NULLO) {
-            if(primo && !virgola) {
-                j.push_back(get_json_null(token));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_null(token));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1669" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-
-        } else if (token.type == TOKEN::GRAFFA_APERTA) {
-            if(primo && !virgola) {
-                j.push_back(get_json_dictionary(t));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_dictionary(t));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1683" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-
-        } else if (token.type == TOKEN::QUADRA_APERTA) {
-            if(primo && !virgola) {
-                j.push_back(get_json_list(t));
-                primo = false;
-            }
-            else if(!primo && virgola){
-                j.push_back(get_json_list(t));
-                virgola = false;
-            }
-            else{
-                std::cout<< "riga 1697" <<std::endl;
-                throw json_exception{"problema virgola"};
-            }
-
-        }
-        else if(token.type == TOKEN::VIRGOLA){
-            if(!virgola){
-                virgola = true;
-            }
-            else{
-                std::cout << "riga 1707"<< std::endl;
-                throw json_exception{"hai ricevuto una virgola non necessaria"};
-            }
-
-        }
-        else{
-            std::cout << "riga 1713 " << token.value<<std::endl;
-            throw json_exception {"formato json non valido"};
-        }
-        token = t.get_token();
-    }
-    return j;
-}
-
-
-std::istream &operator>>(std::istream &lhs, json &rhs) {
-    //std::string st;
-    //st.assign(std::istreambuf_iterator<char>(lhs), std::istreambuf_iterator<char>());
-    //std::cout << st;
-    Tokenizer t = Tokenizer(lhs);
-
-
-    while (true) {
-        Token token = t.get_token();
-        if (token.type == TOKEN::GRAFFA_APERTA) {
-            rhs = get_json_dictionary(t);
-
-        } else if (token.type == TOKEN::STRING) {
-            rhs = get_json_string(token);
-
-        } else if (token.type == TOKEN::NUMBER) {
-            rhs = get_json_number(token);
-
-        } else if (token.type == TOKEN::QUADRA_APERTA) {
-            rhs = get_json_list(t);
-
-        } else if (token.type == TOKEN::BOOLEAN) {
-            rhs = get_json_boolean(token);
-
-        } else if (token.type == TOKEN::NULLO) {
-            rhs = get_json_null(token);
-
-        }
-        else if(token.type == TOKEN::FINE_INPUT){
-            break;
-        }
-        else{
-            std::cout << "riga 1749" << std::endl;
-            throw json_exception {"formato json non valiod"};
-        }
-    }
-    return lhs;
-}
-
-int main() {
-    //here you can test the parser
-
-    return 0;
-}
-
-
+#include "json.hpp"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSON_HAS_MMAP 1
+#endif
+
+/* instruction set used by the structural scanner, JSON_NO_SIMD forces
+   the portable scalar path */
+#if !defined(JSON_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_USE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_USE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define JSON_USE_NEON 1
+#endif
+#endif
+
+/* the counters behind json::read_stats(), one per field of json::stats */
+enum class stat_id : unsigned char {
+    open_brace,
+    close_brace,
+    open_bracket,
+    close_bracket,
+    colon,
+    comma,
+    string,
+    number,
+    boolean,
+    null,
+    documents,
+    bytes,
+    slow_numbers,
+    escaped_strings,
+    allocations,
+    allocated_bytes,
+    copies,
+    moves,
+    index_ns,
+    parse_ns,
+    dump_ns,
+    count,
+};
+
+static constexpr std::size_t stat_count = static_cast<std::size_t>(stat_id::count);
+
+#if defined(JSON_STATS)
+/* The counters of one thread. Only their thread writes them, so they
+   are atomic for read_stats() but never need a locked add. A thread
+   that exits folds its counts into the registry. */
+struct stat_block {
+    stat_block();
+    ~stat_block();
+
+    std::atomic<std::uint64_t> values[stat_count] = {};
+    stat_block *prev = nullptr;
+    stat_block *next = nullptr;
+};
+
+struct stat_registry {
+    std::mutex m;
+    stat_block *head = nullptr;
+    /* the counts of the threads that are gone */
+    std::uint64_t retired[stat_count] = {};
+};
+
+static stat_registry &stats_registry() {
+    static stat_registry r;
+    return r;
+}
+
+stat_block::stat_block() {
+    stat_registry &r = stats_registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    this->next = r.head;
+    if (r.head != nullptr)
+        r.head->prev = this;
+    r.head = this;
+}
+
+stat_block::~stat_block() {
+    stat_registry &r = stats_registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    for (std::size_t i = 0; i != stat_count; ++i)
+        r.retired[i] += this->values[i].load(std::memory_order_relaxed);
+    if (this->prev != nullptr)
+        this->prev->next = this->next;
+    else
+        r.head = this->next;
+    if (this->next != nullptr)
+        this->next->prev = this->prev;
+}
+
+static void count_stat(stat_id s, std::uint64_t n = 1) {
+    thread_local stat_block local;
+    std::atomic<std::uint64_t> &v = local.values[static_cast<std::size_t>(s)];
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/* adds the time from its construction to its destruction to s */
+class stat_timer {
+public:
+    explicit stat_timer(stat_id s) : s(s), start(std::chrono::steady_clock::now()) {}
+    stat_timer(stat_timer const &) = delete;
+
+    ~stat_timer() {
+        auto elapsed = std::chrono::steady_clock::now() - this->start;
+        count_stat(this->s, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    stat_id s;
+    std::chrono::steady_clock::time_point start;
+};
+#else
+static void count_stat(stat_id, std::uint64_t = 1) {}
+
+class stat_timer {
+public:
+    explicit stat_timer(stat_id) {}
+    stat_timer(stat_timer const &) = delete;
+};
+#endif
+
+/* one more heap allocation of n bytes */
+static void count_allocation(std::size_t n) {
+    count_stat(stat_id::allocations);
+    count_stat(stat_id::allocated_bytes, n);
+}
+
+json::stats json::read_stats() {
+    std::uint64_t v[stat_count] = {};
+#if defined(JSON_STATS)
+    stat_registry &r = stats_registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    for (std::size_t i = 0; i != stat_count; ++i)
+        v[i] = r.retired[i];
+    for (stat_block *b = r.head; b != nullptr; b = b->next)
+        for (std::size_t i = 0; i != stat_count; ++i)
+            v[i] += b->values[i].load(std::memory_order_relaxed);
+#endif
+    auto at = [&v](stat_id s) { return v[static_cast<std::size_t>(s)]; };
+    stats st;
+    st.tokens.open_brace = at(stat_id::open_brace);
+    st.tokens.close_brace = at(stat_id::close_brace);
+    st.tokens.open_bracket = at(stat_id::open_bracket);
+    st.tokens.close_bracket = at(stat_id::close_bracket);
+    st.tokens.colon = at(stat_id::colon);
+    st.tokens.comma = at(stat_id::comma);
+    st.tokens.string = at(stat_id::string);
+    st.tokens.number = at(stat_id::number);
+    st.tokens.boolean = at(stat_id::boolean);
+    st.tokens.null = at(stat_id::null);
+    st.documents = at(stat_id::documents);
+    st.bytes = at(stat_id::bytes);
+    st.slow_numbers = at(stat_id::slow_numbers);
+    st.escaped_strings = at(stat_id::escaped_strings);
+    st.allocations = at(stat_id::allocations);
+    st.allocated_bytes = at(stat_id::allocated_bytes);
+    st.copies = at(stat_id::copies);
+    st.moves = at(stat_id::moves);
+    st.index_ns = at(stat_id::index_ns);
+    st.parse_ns = at(stat_id::parse_ns);
+    st.dump_ns = at(stat_id::dump_ns);
+    return st;
+}
+
+void json::reset_stats() {
+#if defined(JSON_STATS)
+    stat_registry &r = stats_registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    for (std::size_t i = 0; i != stat_count; ++i)
+        r.retired[i] = 0;
+    for (stat_block *b = r.head; b != nullptr; b = b->next)
+        for (std::size_t i = 0; i != stat_count; ++i)
+            b->values[i].store(0, std::memory_order_relaxed);
+#endif
+}
+
+
+/* Bump allocator: memory is carved out of big blocks and only given
+   back all at once. */
+struct json::arena {
+    arena() = default;
+    arena(arena const &) = delete;
+    arena &operator=(arena const &) = delete;
+
+    ~arena() {
+        release_owned();
+        while (head != nullptr) {
+            block *next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+
+    void *allocate(std::size_t n, std::size_t align) {
+        char *p = align_up(cur, align);
+        if (p == nullptr || p > end || n > static_cast<std::size_t>(end - p)) {
+            new_block(n + align);
+            p = align_up(cur, align);
+        }
+        cur = p + n;
+        return p;
+    }
+
+    /* grows in place the last allocation, if nothing was allocated after it */
+    bool extend(void *p, std::size_t old_n, std::size_t new_n) {
+        char *q = static_cast<char *>(p);
+        if (q + old_n != cur || new_n - old_n > static_cast<std::size_t>(end - cur))
+            return false;
+        cur = q + new_n;
+        return true;
+    }
+
+    /* frees everything but the most recent (and largest) block */
+    void reset() {
+        release_owned();
+        if (head == nullptr)
+            return;
+        while (head->next != nullptr) {
+            block *next = head->next->next;
+            reserved -= head->next->size;
+            ::operator delete(head->next);
+            head->next = next;
+        }
+        cur = reinterpret_cast<char *>(head + 1);
+    }
+
+    std::size_t size() const {
+        return reserved;
+    }
+
+    /* would v leak if its arena storage were dropped without destroying it? */
+    static bool owns_heap(json const &v);
+    static bool owns_heap(std::string const &s);
+
+    /* heap objects destroyed together with the arena content */
+    struct owned {
+        owned *next = nullptr;
+        virtual ~owned() = default;
+    };
+
+    template<typename T>
+    struct owned_value : owned {
+        T value;
+
+        template<typename... Args>
+        explicit owned_value(Args &&... args) : value(std::forward<Args>(args)...) {}
+    };
+
+    template<typename T, typename... Args>
+    T *make(Args &&... args) {
+        auto *o = new owned_value<T>(std::forward<Args>(args)...);
+        count_allocation(sizeof(*o));
+        push_owned(o);
+        return &o->value;
+    }
+
+    /* the std::string for a borrowed string, created only once even when
+       several threads ask for it at the same time */
+    std::string const &materialize(std::atomic<std::string *> &slot, const char *p, std::size_t n) {
+        auto *o = new owned_value<std::string>(p, n);
+        std::string *expected = nullptr;
+        if (slot.compare_exchange_strong(expected, &o->value, std::memory_order_acq_rel)) {
+            count_allocation(sizeof(*o));
+            if (owns_heap(o->value))
+                count_allocation(n + 1);
+            push_owned(o);
+            return o->value;
+        }
+        delete o;
+        return *expected;
+    }
+
+private:
+    /* lock free, since materialize() runs on behalf of const readers */
+    void push_owned(owned *o) {
+        o->next = owned_head.load(std::memory_order_relaxed);
+        while (!owned_head.compare_exchange_weak(o->next, o, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    void release_owned() {
+        owned *o = owned_head.exchange(nullptr, std::memory_order_acquire);
+        while (o != nullptr) {
+            owned *next = o->next;
+            delete o;
+            o = next;
+        }
+    }
+
+    struct alignas(std::max_align_t) block {
+        block *next;
+        std::size_t size;
+    };
+
+    static char *align_up(char *p, std::size_t align) {
+        uintptr_t x = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char *>((x + align - 1) & ~(uintptr_t(align) - 1));
+    }
+
+    /* blocks double from 64 KiB up to 16 MiB */
+    void new_block(std::size_t min) {
+        std::size_t n = next_size;
+        if (n < min + sizeof(block)) n = min + sizeof(block);
+        if (next_size < (std::size_t(16) << 20)) next_size *= 2;
+        block *b = static_cast<block *>(::operator new(n));
+        count_allocation(n);
+        b->next = head;
+        b->size = n;
+        head = b;
+        reserved += n;
+        cur = reinterpret_cast<char *>(b + 1);
+        end = reinterpret_cast<char *>(b) + n;
+    }
+
+    block *head = nullptr;
+    char *cur = nullptr;
+    char *end = nullptr;
+    std::size_t next_size = std::size_t(64) << 10;
+    std::size_t reserved = 0;
+    std::atomic<owned *> owned_head{nullptr};
+};
+
+
+template<typename Val>
+class vector {
+public:
+
+    /* default constructor: no allocation until the first push */
+    vector();
+
+    /* the buffer will be taken from a, which then owns it */
+    explicit vector(json::arena *a);
+
+    /* copy constructor */
+    vector(vector<Val> const &rhs);
+
+    /* move constructor */
+    vector(vector<Val> &&rhs);
+
+    /* destructor */
+    ~vector();
+
+    /* removes all the elements, keeps the allocated buffer */
+    void clear();
+
+    /* number of elements in the container */
+    uint64_t size() const;
+
+    /* number of elements that fit before the buffer has to grow */
+    uint64_t capacity() const;
+
+    /* is the container empty? */
+    bool empty() const;
+
+    /* makes room for at least n elements without reallocating */
+    void reserve(uint64_t n);
+
+    /* push to the back a copy of v, amortized O(1) */
+    void push_back(Val const &v);
+
+    /* push to the back v by moving it, amortized O(1) */
+    void push_back(Val &&v);
+
+    /* push to the front a new element with value v, O(n) */
+    void push_front(Val v);
+
+    /* remove last element */
+    void pop_back();
+
+    /* copy assignment operator */
+    vector<Val> &operator=(vector<Val> const &rhs);
+
+    /* move assignment operator */
+    vector<Val> &operator=(vector<Val> &&rhs);
+
+    /* returns a const reference to the i-th element, O(1) */
+    Val const &operator[](uint64_t i) const;
+
+    /* returns a reference to the i-th element, O(1) */
+    Val &operator[](uint64_t i);
+
+    /* the elements are contiguous, so plain pointers are
+       random access iterators */
+    using iterator = Val *;
+    using const_iterator = Val const *;
+
+    iterator begin();
+
+    iterator end();
+
+    const_iterator cbegin() const;
+
+    const_iterator cend() const;
+
+    Val *back();
+
+private:
+    /* moves the elements into a new buffer of n slots */
+    void grow(uint64_t n);
+
+    Val *m_data;        // first element
+    uint64_t m_size;    // constructed elements
+    uint64_t m_cap;     // allocated slots
+    json::arena *m_arena;  // nullptr when the buffer is on the heap
+};
+
+
+/* default constructor */
+template<typename Val>
+vector<Val>::vector() : m_data(nullptr), m_size(0), m_cap(0), m_arena(nullptr) {}
+
+template<typename Val>
+vector<Val>::vector(json::arena *a) : m_data(nullptr), m_size(0), m_cap(0), m_arena(a) {}
+
+/* copy constructor: the copy is always on the heap */
+template<typename Val>
+vector<Val>::vector(vector<Val> const &rhs)
+        : vector()  // calls the default constructor
+{
+    reserve(rhs.m_size);
+    for (uint64_t i = 0; i != rhs.m_size; ++i)
+        push_back(rhs.m_data[i]);
+}
+
+/* move constructor */
+template<typename Val>
+vector<Val>::vector(vector<Val> &&rhs)
+        : m_data(rhs.m_data), m_size(rhs.m_size), m_cap(rhs.m_cap), m_arena(rhs.m_arena)
+{
+    rhs.m_data = nullptr;
+    rhs.m_size = 0;
+    rhs.m_cap = 0;
+}
+
+/* destructor */
+template<typename Val>
+vector<Val>::~vector() {
+    clear();
+    if (m_arena == nullptr)
+        ::operator delete(m_data);
+}
+
+/* copy assignment operator */
+template<typename Val>
+vector<Val> &vector<Val>::operator=(vector<Val> const &rhs) {
+    if (this != &rhs) {  // not a self-assignment
+        clear();
+        reserve(rhs.m_size);
+        for (uint64_t i = 0; i != rhs.m_size; ++i)
+            push_back(rhs.m_data[i]);
+    }
+    return *this;
+}
+
+/* move assignment operator */
+template<typename Val>
+vector<Val> &vector<Val>::operator=(vector<Val> &&rhs) {
+    if (this != &rhs) {  // not a self-assignment
+        clear();
+        if (m_arena == nullptr)
+            ::operator delete(m_data);
+        m_data = rhs.m_data;
+        m_size = rhs.m_size;
+        m_cap = rhs.m_cap;
+        m_arena = rhs.m_arena;
+        rhs.m_data = nullptr;
+        rhs.m_size = 0;
+        rhs.m_cap = 0;
+    }
+    return *this;
+}
+
+template<typename Val>
+void vector<Val>::clear() {
+    while (m_size) pop_back();
+}
+
+template<typename Val>
+uint64_t vector<Val>::size() const {
+    return m_size;
+}
+
+template<typename Val>
+uint64_t vector<Val>::capacity() const {
+    return m_cap;
+}
+
+template<typename Val>
+bool vector<Val>::empty() const {
+    return m_size == 0;
+}
+
+template<typename Val>
+void vector<Val>::grow(uint64_t n) {
+    Val *data;
+    if (m_arena != nullptr) {
+        if (m_data != nullptr && m_arena->extend(m_data, m_cap * sizeof(Val), n * sizeof(Val))) {
+            m_cap = n;
+            return;
+        }
+        data = static_cast<Val *>(m_arena->allocate(n * sizeof(Val), alignof(Val)));
+    } else {
+        data = static_cast<Val *>(::operator new(n * sizeof(Val)));
+        count_allocation(n * sizeof(Val));
+    }
+    for (uint64_t i = 0; i != m_size; ++i) {
+        new(data + i) Val(std::move(m_data[i]));
+        m_data[i].~Val();
+    }
+    if (m_arena == nullptr)
+        ::operator delete(m_data);
+    m_data = data;
+    m_cap = n;
+}
+
+template<typename Val>
+void vector<Val>::reserve(uint64_t n) {
+    if (n > m_cap) grow(n);
+}
+
+/* the buffer doubles when full, so n pushes cost O(n) moves overall */
+template<typename Val>
+void vector<Val>::push_back(Val const &v) {
+    if (m_size == m_cap) {
+        Val tmp(v);  // v may live inside the buffer we are about to move
+        grow(m_cap ? 2 * m_cap : 4);
+        new(m_data + m_size) Val(std::move(tmp));
+    } else {
+        new(m_data + m_size) Val(v);
+    }
+    ++m_size;
+}
+
+template<typename Val>
+void vector<Val>::push_back(Val &&v) {
+    if (m_size == m_cap) {
+        Val tmp(std::move(v));
+        grow(m_cap ? 2 * m_cap : 4);
+        new(m_data + m_size) Val(std::move(tmp));
+    } else {
+        new(m_data + m_size) Val(std::move(v));
+    }
+    ++m_size;
+}
+
+/* shifts every element one slot to the right */
+template<typename Val>
+void vector<Val>::push_front(Val v) {
+    push_back(std::move(v));
+    for (uint64_t i = m_size - 1; i != 0; --i)
+        std::swap(m_data[i], m_data[i - 1]);
+}
+
+template<typename Val>
+void vector<Val>::pop_back() {
+    if (m_size) m_data[--m_size].~Val();
+}
+
+template<typename Val>
+Val const &vector<Val>::operator[](uint64_t i) const {
+    return m_data[i];
+}
+
+template<typename Val>
+Val &vector<Val>::operator[](uint64_t i) {
+    return m_data[i];
+}
+
+template<typename Val>
+typename vector<Val>::iterator vector<Val>::begin() {
+    return m_data;
+}
+
+template<typename Val>
+typename vector<Val>::iterator vector<Val>::end() {
+    return m_data + m_size;
+}
+
+template<typename Val>
+typename vector<Val>::const_iterator vector<Val>::cbegin() const {
+    return m_data;
+}
+
+template<typename Val>
+typename vector<Val>::const_iterator vector<Val>::cend() const {
+    return m_data + m_size;
+}
+
+template<typename Val>
+Val *vector<Val>::back() {
+    return m_data + m_size - 1;
+}
+
+
+/* Container storage is either on the heap or inside a document arena.
+   Arena storage is never freed one by one: while pure (no descendant
+   holds heap memory) destroying it is a no-op, otherwise only the
+   elements are destroyed. Every non-const path into the elements goes
+   through writable(), since the caller may store heap owning values.
+   Heap storage is shared by the copies of a value, refs counting them,
+   and copied by json::own_list() or own_dictionary() before a change.
+   Once writable() has handed out a way to change the elements behind
+   the back of the owner, the storage is no longer shared by copies. */
+struct json::list_storage {
+    vector<json> items;
+    arena *owner = nullptr;
+    bool pure = true;
+    bool shareable = true;
+    std::atomic<std::size_t> refs{1};
+
+    list_storage() = default;
+
+    explicit list_storage(arena *a) : items(a), owner(a) {}
+
+    /* copies always land on the heap */
+    list_storage(list_storage const &rhs) : items(rhs.items) {}
+
+    vector<json> &writable() {
+        pure = false;
+        shareable = false;
+        return items;
+    }
+};
+
+/* Entries are kept in insertion order in a vector; once the dictionary
+   grows past index_threshold entries an open addressing table is built
+   on top of it. Each slot packs the upper 32 bits of the key hash with
+   position + 1 of the entry (0 marks an empty slot), so most probes are
+   settled without touching the key strings.
+   Inside a document, a dictionary with the same keys in the same order
+   as the one parsed before it at the same depth, as in a list of
+   records, borrows the table of that one instead of building its own.
+   A table that has been lent is never changed in place again: the
+   arena keeps the old copy alive for the borrowers. */
+struct json::dictionary_storage {
+    static constexpr uint64_t index_threshold = 8;
+
+    vector<std::pair<std::string, json>> items;
+    vector<uint64_t> index;  // empty while items.size() <= index_threshold
+    const uint64_t *shared = nullptr;  // a borrowed table, used instead of index
+    uint64_t shared_size = 0;
+    bool lent = false;       // index is borrowed by other dictionaries
+    arena *owner = nullptr;  // see list_storage
+    bool pure = true;
+    bool shareable = true;
+    std::atomic<std::size_t> refs{1};
+
+    dictionary_storage() = default;
+
+    explicit dictionary_storage(arena *a) : items(a), index(a), owner(a) {}
+
+    dictionary_storage(dictionary_storage const &rhs) : items(rhs.items), index(rhs.index) {
+        for (uint64_t i = 0; i != rhs.shared_size; ++i)
+            index.push_back(rhs.shared[i]);
+    }
+
+    dictionary_storage &writable() {
+        pure = false;
+        shareable = false;
+        return *this;
+    }
+
+    static uint64_t hash(std::string_view key) {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    /* returns the entry with the given key, nullptr if missing */
+    std::pair<std::string, json> *find(std::string_view key) {
+        if (table_size() == 0)
+            return this->scan(key);
+        return this->find(key, hash(key));
+    }
+
+    /* same, h being hash(key) worked out by the caller */
+    std::pair<std::string, json> *find(std::string_view key, uint64_t h) {
+        uint64_t size = table_size();
+        if (size == 0)
+            return this->scan(key);
+        const uint64_t *table = shared != nullptr ? shared : index.begin();
+        uint64_t mask = size - 1;
+        for (uint64_t i = h & mask;; i = (i + 1) & mask) {
+            uint64_t slot = table[i];
+            if (slot == 0) return nullptr;
+            if ((slot >> 32) == (h >> 32)) {
+                auto &entry = items[(slot & 0xffffffff) - 1];
+                if (entry.first == key) return &entry;
+            }
+        }
+    }
+
+    /* appends a new entry, the key must not be present already */
+    std::pair<std::string, json> &append(std::pair<std::string, json> x) {
+        items.push_back(std::move(x));
+        if (shared != nullptr || lent)
+            own_index();
+        if (!index.empty() && 2 * items.size() <= index.size())
+            index_entry(items.size() - 1);
+        else if (items.size() > index_threshold)
+            rebuild_index();
+        return *items.back();
+    }
+
+    /* appends without looking for the key nor indexing it, see reindex() */
+    void append_unindexed(std::pair<std::string, json> &&x) {
+        items.push_back(std::move(x));
+    }
+
+    /* builds the table for entries added by append_unindexed() */
+    void reindex() {
+        if (items.size() > index_threshold)
+            rebuild_index();
+    }
+
+    /* Removes the entries at the ascending positions [first, last), the
+       others moving down in order, and indexes what is left again. */
+    void erase(const uint64_t *first, const uint64_t *last) {
+        if (first == last)
+            return;
+        uint64_t kept = *first;
+        for (uint64_t pos = *first; pos != items.size(); ++pos) {
+            if (first != last && pos == *first)
+                ++first;
+            else
+                items[kept++] = std::move(items[pos]);
+        }
+        while (items.size() != kept)
+            items.pop_back();
+        if (shared != nullptr || lent) {
+            /* the borrowers keep the old table */
+            index = vector<uint64_t>(owner);
+            shared = nullptr;
+            shared_size = 0;
+            lent = false;
+        }
+        if (items.size() > index_threshold)
+            rebuild_index();
+        else
+            index.clear();
+    }
+
+    /* uses the table of shape, whose keys are the same as ours */
+    void share_index(dictionary_storage &shape) {
+        if (shape.shared != nullptr) {
+            shared = shape.shared;
+            shared_size = shape.shared_size;
+        } else if (!shape.index.empty()) {
+            shared = shape.index.begin();
+            shared_size = shape.index.size();
+            shape.lent = true;
+        }
+    }
+
+private:
+    uint64_t table_size() const {
+        return shared != nullptr ? shared_size : index.size();
+    }
+
+    std::pair<std::string, json> *scan(std::string_view key) {
+        for (auto it = items.begin(); it != items.end(); ++it)
+            if (it->first == key) return it;
+        return nullptr;
+    }
+
+    /* stops using a borrowed or lent table, keeping its content */
+    void own_index() {
+        vector<uint64_t> copy(owner);
+        uint64_t n = table_size();
+        const uint64_t *table = shared != nullptr ? shared : index.begin();
+        copy.reserve(n);
+        for (uint64_t i = 0; i != n; ++i) copy.push_back(table[i]);
+        index = std::move(copy);
+        shared = nullptr;
+        shared_size = 0;
+        lent = false;
+    }
+
+    void index_entry(uint64_t pos) {
+        uint64_t h = hash(items[pos].first);
+        uint64_t mask = index.size() - 1;
+        uint64_t i = h & mask;
+        while (index[i] != 0) i = (i + 1) & mask;
+        index[i] = (h >> 32 << 32) | (pos + 1);
+    }
+
+    /* keeps the load factor at most 1/2 */
+    void rebuild_index() {
+        uint64_t n = 16;
+        while (n < 4 * items.size()) n *= 2;
+        index.clear();
+        index.reserve(n);
+        for (uint64_t i = 0; i != n; ++i) index.push_back(0);
+        for (uint64_t pos = 0; pos != items.size(); ++pos) index_entry(pos);
+    }
+};
+
+bool json::arena::owns_heap(json const &v) {
+    switch (v.tag) {
+        case kind::string:
+            return owns_heap(v.s);
+        case kind::list:
+            return v.l->owner == nullptr || !v.l->pure;
+        case kind::dictionary:
+            return v.dict->owner == nullptr || !v.dict->pure;
+        default:
+            return false;
+    }
+}
+
+/* short strings live inside the std::string object itself */
+bool json::arena::owns_heap(std::string const &s) {
+    const char *self = reinterpret_cast<const char *>(&s);
+    return s.data() < self || s.data() >= self + sizeof(s);
+}
+
+/* drops a reference to heap storage, the last one deletes it */
+template<typename Storage>
+static void release_storage(Storage *storage) {
+    if (storage->refs.load(std::memory_order_acquire) == 1 || storage->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete storage;
+}
+
+/* shares heap storage with one more value, nullptr if it must be copied */
+template<typename Storage>
+static Storage *share_storage(Storage *storage) {
+    if (storage->owner != nullptr || !storage->shareable)
+        return nullptr;
+    storage->refs.fetch_add(1, std::memory_order_relaxed);
+    return storage;
+}
+
+void json::destroy() {
+    switch (this->tag) {
+        case kind::string:
+            this->s.~basic_string();
+            break;
+        case kind::list:
+            if (this->l->owner == nullptr)
+                release_storage(this->l);
+            else if (!this->l->pure)
+                this->l->~list_storage();
+            break;
+        case kind::dictionary:
+            if (this->dict->owner == nullptr)
+                release_storage(this->dict);
+            else if (!this->dict->pure)
+                this->dict->~dictionary_storage();
+            break;
+        default:
+            break;
+    }
+    this->tag = kind::null;
+}
+
+void json::copy_from(json const &j) {
+    switch (j.tag) {
+        case kind::number:
+            this->number = j.number;
+            break;
+        case kind::integer:
+            this->integer = j.integer;
+            break;
+        case kind::boolean:
+            this->b = j.b;
+            break;
+        case kind::string:
+            new(&this->s) std::string(j.s);
+            if (arena::owns_heap(this->s))
+                count_allocation(this->s.capacity() + 1);
+            break;
+        case kind::string_ref:
+            /* a copy does not depend on the document */
+            new(&this->s) std::string(j.ref.data, j.ref.size);
+            count_allocation(this->s.capacity() + 1);
+            this->tag = kind::string;
+            return;
+        case kind::list:
+            this->l = share_storage(j.l);
+            if (this->l == nullptr) {
+                this->l = new list_storage(*j.l);
+                count_allocation(sizeof(list_storage));
+            }
+            break;
+        case kind::dictionary:
+            this->dict = share_storage(j.dict);
+            if (this->dict == nullptr) {
+                this->dict = new dictionary_storage(*j.dict);
+                count_allocation(sizeof(dictionary_storage));
+            }
+            break;
+        default:
+            break;
+    }
+    this->tag = j.tag;
+}
+
+json::list_storage &json::own_list() {
+    if (this->l->refs.load(std::memory_order_acquire) != 1) {
+        list_storage *copy = new list_storage(*this->l);
+        count_allocation(sizeof(list_storage));
+        release_storage(this->l);
+        this->l = copy;
+    }
+    return *this->l;
+}
+
+json::dictionary_storage &json::own_dictionary() {
+    if (this->dict->refs.load(std::memory_order_acquire) != 1) {
+        dictionary_storage *copy = new dictionary_storage(*this->dict);
+        count_allocation(sizeof(dictionary_storage));
+        release_storage(this->dict);
+        this->dict = copy;
+    }
+    return *this->dict;
+}
+
+/* steals the payload of j, which is left as null */
+void json::move_from(json &&j) {
+    switch (j.tag) {
+        case kind::number:
+            this->number = j.number;
+            break;
+        case kind::integer:
+            this->integer = j.integer;
+            break;
+        case kind::boolean:
+            this->b = j.b;
+            break;
+        case kind::string:
+            new(&this->s) std::string(std::move(j.s));
+            j.s.~basic_string();
+            break;
+        case kind::string_ref:
+            new(&this->ref) string_ref_data{j.ref.data, j.ref.size, j.ref.owner,
+                                            {j.ref.cache.load(std::memory_order_acquire)}};
+            break;
+        case kind::list:
+            this->l = j.l;
+            break;
+        case kind::dictionary:
+            this->dict = j.dict;
+            break;
+        default:
+            break;
+    }
+    this->tag = j.tag;
+    j.tag = kind::null;
+}
+
+bool json::is_list() const {
+    return this->tag == kind::list;
+}
+
+bool json::is_dictionary() const {
+    return this->tag == kind::dictionary;
+}
+
+bool json::is_string() const {
+    return this->tag == kind::string || this->tag == kind::string_ref;
+}
+
+bool json::is_number() const {
+    return this->tag == kind::number || this->tag == kind::integer;
+}
+
+bool json::is_integer() const {
+    return this->tag == kind::integer;
+}
+
+bool json::is_bool() const {
+    return this->tag == kind::boolean;
+}
+
+bool json::is_null() const {
+    return this->tag == kind::null;
+}
+
+struct json::list_iterator {
+    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
+    using value_type = json;
+    using pointer = json *;
+    using reference = json &;
+
+    /* constructor */
+    list_iterator(vector<json>::iterator _it) : it(_it) {}
+
+    /* we let the compiler define the destructor
+       and copy constructor/assignment */
+
+    reference operator*() const {
+        return *this->it;
+    }
+
+    /* ritorna puntatore all'elemento corrente della lista  */
+    pointer operator->() const {
+        return &(*this->it);
+    }
+
+    /* prefix increment: advance the iterator to the next element
+       and return it. */
+    list_iterator &operator++() {
+        ++(this->it);
+        return *this;
+    }
+
+    /* postfix increment: copy the iterator, advance the
+       iterator to the next element, and return the copy. */
+    list_iterator operator++(int /* dummy */) {
+        list_iterator copy = *this;
+        ++(this->it);
+        return copy;
+    }
+
+    bool operator==(list_iterator const &rhs) const {
+        return this->it == rhs.it;
+    }
+
+
+    bool operator!=(list_iterator const &rhs) const {
+        return !(this->it == rhs.it);
+    }
+
+private:
+    vector<json>::iterator it;
+};
+
+
+struct json::const_list_iterator {
+    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
+    using value_type = const json;
+    using const_pointer = json const *;
+    using const_reference = json const &;
+
+    /* constructor */
+    const_list_iterator(const vector<json>::const_iterator _it) : it(_it) {}
+
+    /* we let the compiler define the destructor
+       and copy constructor/assignment */
+
+    const_reference operator*() const {
+        return *this->it;
+    }
+
+    /* ritorna puntatore all'elemento corrente della lista  */
+    const_pointer operator->() const {
+        return &(*this->it);
+    }
+
+    /* prefix increment: advance the iterator to the next element
+       and return it. */
+    const_list_iterator &operator++() {
+        ++(this->it);
+        return *this;
+    }
+
+    /* postfix increment: copy the iterator, advance the
+       iterator to the next element, and return the copy. */
+    const_list_iterator operator++(int /* dummy */) {
+        const_list_iterator copy = *this;
+        ++(this->it);
+        return copy;
+    }
+
+    bool operator==(const_list_iterator const &rhs) const {
+        return this->it == rhs.it;
+    }
+
+
+    bool operator!=(const_list_iterator const &rhs) const {
+        return !(*this == rhs); //!(this->it == rhs.it);
+    }
+
+private:
+    vector<json>::const_iterator it;
+};
+
+
+struct json::dictionary_iterator {
+    /* an input iterator only: *it is a proxy returned by value, not a
+       value_type& as a forward iterator's has to be */
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::pair<std::string, json>;
+    using difference_type = std::ptrdiff_t;
+
+    /* The entry, its key read only: the index of the dictionary is
+       built on the keys, so a key can only change with erase() and
+       insert(). */
+    struct reference {
+        std::string const &first;
+        json &second;
+    };
+
+    /* what operator-> hands out, holding the reference */
+    struct pointer {
+        reference entry;
+
+        reference const *operator->() const {
+            return &this->entry;
+        }
+    };
+
+    /* constructor */
+    dictionary_iterator(const vector<std::pair<std::string, json>>::iterator _it) : it(_it) {}
+
+    /* we let the compiler define the destructor
+       and copy constructor/assignment */
+
+    reference operator*() const {
+        return {this->it->first, this->it->second};
+    }
+
+    /* ritorna puntatore all'elemento corrente della lista  */
+    pointer operator->() const {
+        return {**this};
+    }
+
+    /* prefix increment: advance the iterator to the next element
+       and return it. */
+    dictionary_iterator &operator++() {
+        ++(this->it);
+        return *this;
+    }
+
+    /* postfix increment: copy the iterator, advance the
+       iterator to the next element, and return the copy. */
+    dictionary_iterator operator++(int /* dummy */) {
+        dictionary_iterator copy = *this;
+        ++(this->it);
+        return copy;
+    }
+
+    bool operator==(dictionary_iterator const &rhs) const {
+        return this->it == rhs.it;
+    }
+
+
+    bool operator!=(dictionary_iterator const &rhs) const {
+        return !(this->it == rhs.it);
+    }
+
+private:
+    vector<std::pair<std::string, json>>::iterator it;
+};
+
+
+struct json::const_dictionary_iterator {
+    using iterator_category = std::forward_iterator_tag;    //stub dell'iteratore delle liste
+    using value_type = const std::pair<std::string, json>;
+    using const_pointer = std::pair<std::string, json> const *;
+    using const_reference = std::pair<std::string, json> const &;
+
+    /* constructor */
+    const_dictionary_iterator(vector<std::pair<std::string, json>>::const_iterator _it) : it(_it) {}
+
+    /* we let the compiler define the destructor
+       and copy constructor/assignment */
+
+    const_reference operator*() const {
+        return *this->it;
+    }
+
+    /* ritorna puntatore all'elemento corrente della lista  */
+    const_pointer operator->() const {
+        return &(*this->it);
+    }
+
+    /* prefix increment: advance the iterator to the next element
+       and return it. */
+    const_dictionary_iterator &operator++() {
+        ++(this->it);
+        return *this;
+    }
+
+    /* postfix increment: copy the iterator, advance the
+       iterator to the next element, and return the copy. */
+    const_dictionary_iterator operator++(int /* dummy */) {
+        const_dictionary_iterator copy = *this;
+        ++(this->it);
+        return copy;
+    }
+
+    bool operator==(const_dictionary_iterator const &rhs) const {
+        return this->it == rhs.it;
+    }
+
+
+    bool operator!=(const_dictionary_iterator const &rhs) const {
+        return !(*this == rhs); //!(this->it == rhs.it);
+    }
+
+private:
+    vector<std::pair<std::string, json>>::const_iterator it;
+};
+
+
+json::list_iterator json::begin_list() {
+    if (!this->is_list()) {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+    else {
+        return list_iterator(this->own_list().writable().begin());
+    }
+}
+
+json::list_iterator json::end_list() {
+    if (!this->is_list()) {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+    else {
+        return list_iterator(this->own_list().writable().end());
+    }
+}
+
+json::const_list_iterator json::begin_list() const {
+    if (!this->is_list()) {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+    else {
+        return const_list_iterator(this->l->items.cbegin());
+    }
+}
+
+json::const_list_iterator json::end_list() const {
+    if (!this->is_list()) {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+    else {
+        return const_list_iterator(this->l->items.cend());
+    }
+}
+
+
+json::dictionary_iterator json::begin_dictionary() {
+    if (!this->is_dictionary()) {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+    else {
+        return dictionary_iterator(this->own_dictionary().writable().items.begin());
+    }
+}
+
+json::dictionary_iterator json::end_dictionary() {
+    if (!this->is_dictionary()) {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+    else {
+        return dictionary_iterator(this->own_dictionary().writable().items.end());
+    }
+}
+
+json::const_dictionary_iterator json::begin_dictionary() const {
+    if (!this->is_dictionary()) {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+    else {
+        return const_dictionary_iterator(this->dict->items.cbegin());
+    }
+}
+
+json::const_dictionary_iterator json::end_dictionary() const {
+    if (!this->is_dictionary()) {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+    else {
+        return const_dictionary_iterator(this->dict->items.cend());
+    }
+}
+
+
+
+json const &json::operator[](std::string_view kiave) const {
+    if (!this->is_dictionary()){
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+
+
+    if (auto entry = this->dict->find(kiave))
+        return entry->second;
+    throw json_exception{"key not found: " + std::string(kiave), json_errc::not_found};
+}
+
+json &json::operator[](std::string_view kiave) {
+    if (!this->is_dictionary()) {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+
+
+    dictionary_storage &storage = this->own_dictionary().writable();
+    if (auto entry = storage.find(kiave))
+        return entry->second;
+    return storage.append(std::pair<std::string, json>(std::string(kiave), json())).second;
+
+}
+
+json const &json::operator[](std::size_t i) const {
+    if (!this->is_list())
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    if (i >= this->l->items.size())
+        throw json_exception{"list index out of range", json_errc::out_of_range};
+    return this->l->items[i];
+}
+
+json &json::operator[](std::size_t i) {
+    if (!this->is_list())
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    if (i >= this->l->items.size())
+        throw json_exception{"list index out of range", json_errc::out_of_range};
+    return this->own_list().writable()[i];
+}
+
+std::size_t json::size() const {
+    if (this->is_list())
+        return this->l->items.size();
+    if (this->is_dictionary())
+        return this->dict->items.size();
+    throw json_exception{"this is not a list or a dictionary", json_errc::wrong_type};
+}
+
+json::json() : tag(kind::null) {}
+
+json::~json() {
+    this->destroy();
+}
+
+json::json(json const &j) : json() {
+    count_stat(stat_id::copies);
+    this->copy_from(j);
+}
+
+json::json(json &&j) noexcept : json() {
+    count_stat(stat_id::moves);
+    this->move_from(std::move(j));
+}
+
+json &json::operator=(json const &j) {
+    count_stat(stat_id::copies);
+    if (this != &j) {  // not a self-assignment
+        /* j may be part of our own tree, copy it before letting go of
+           the old value */
+        json copy;
+        copy.copy_from(j);
+        this->destroy();
+        this->move_from(std::move(copy));
+    }
+    return *this;
+}
+
+
+json &json::operator=(json &&j) noexcept {
+    count_stat(stat_id::moves);
+    if (this != &j) {  // not a self-assignment
+        /* first delete all items (and free the memory) */
+        this->destroy();
+        this->move_from(std::move(j));
+    }
+    return *this;
+}
+
+
+double &json::get_number() {
+    if (this->tag == kind::integer) {
+        /* the caller may write through the reference */
+        double x = static_cast<double>(this->integer);
+        this->number = x;
+        this->tag = kind::number;
+    }
+    if (this->is_number())
+        return this->number;
+    else {
+        throw json_exception{"this is not a number", json_errc::wrong_type};
+    }
+}
+
+double json::get_number() const {
+    if (this->tag == kind::integer)
+        return static_cast<double>(this->integer);
+    if (this->is_number())
+        return this->number;
+    else {
+        throw json_exception{"this is not a number", json_errc::wrong_type};
+    }
+}
+
+std::int64_t json::get_integer() const {
+    if (this->is_integer())
+        return this->integer;
+    throw json_exception{"this is not an integer", json_errc::wrong_type};
+}
+
+bool &json::get_bool() {
+    if (this->is_bool())
+        return this->b;
+    else {
+        throw json_exception{"this is not a bool", json_errc::wrong_type};
+    }
+}
+
+bool const &json::get_bool() const {
+    if (this->is_bool())
+        return this->b;
+    else {
+        throw json_exception{"this is not a bool", json_errc::wrong_type};
+    }
+}
+
+std::string &json::get_string() {
+    if (this->tag == kind::string_ref) {
+        /* the caller may modify it: make it a string of its own */
+        string_ref_data r = {this->ref.data, this->ref.size, this->ref.owner, {nullptr}};
+        new(&this->s) std::string(r.data, r.size);
+        count_allocation(this->s.capacity() + 1);
+        this->tag = kind::string;
+    }
+    if (this->is_string())
+        return this->s;
+    else {
+        throw json_exception{"this is not a string", json_errc::wrong_type};
+    }
+}
+
+std::string const &json::get_string() const {
+    if (this->tag == kind::string_ref) {
+        std::string *cached = this->ref.cache.load(std::memory_order_acquire);
+        if (cached != nullptr)
+            return *cached;
+        return this->ref.owner->materialize(this->ref.cache, this->ref.data, this->ref.size);
+    }
+    if (this->is_string())
+        return this->s;
+    else {
+        throw json_exception{"this is not a string", json_errc::wrong_type};
+    }
+}
+
+std::string_view json::get_string_view() const {
+    if (this->tag == kind::string_ref)
+        return {this->ref.data, this->ref.size};
+    if (this->tag == kind::string)
+        return this->s;
+    throw json_exception{"this is not a string", json_errc::wrong_type};
+}
+
+void json::set_string(const std::string &x) {
+    if (this->tag == kind::string) {
+        this->s = x;  // x may alias our own string
+        return;
+    }
+    this->destroy();
+    new(&this->s) std::string(x);
+    this->tag = kind::string;
+}
+
+void json::set_bool(bool x) {
+    this->destroy();
+    this->b = x;
+    this->tag = kind::boolean;
+}
+
+void json::set_number(double x) {
+    this->destroy();
+    this->number = x;
+    this->tag = kind::number;
+}
+
+void json::set_integer(std::int64_t x) {
+    this->destroy();
+    this->integer = x;
+    this->tag = kind::integer;
+}
+
+void json::set_null() {
+    this->destroy();
+}
+
+void json::set_list() {
+    list_storage *tmp = new list_storage;
+    count_allocation(sizeof(list_storage));
+    this->destroy();
+    this->l = tmp;
+    this->tag = kind::list;
+}
+
+void json::set_dictionary() {
+    dictionary_storage *tmp = new dictionary_storage;
+    count_allocation(sizeof(dictionary_storage));
+    this->destroy();
+    this->dict = tmp;
+    this->tag = kind::dictionary;
+}
+
+void json::push_front(const json &x) {
+    this->push_front(json(x));
+}
+
+void json::push_front(json &&x) {
+    if (this->is_list()) {
+        list_storage &storage = this->own_list();
+        if (arena::owns_heap(x))
+            storage.pure = false;
+        storage.items.push_front(std::move(x));
+    } else {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+}
+
+void json::push_back(const json &x) {
+    this->push_back(json(x));
+}
+
+/* an arena list stays pure unless x holds heap memory */
+void json::push_back(json &&x) {
+    if (this->is_list()) {
+        list_storage &storage = this->own_list();
+        if (arena::owns_heap(x))
+            storage.pure = false;
+        storage.items.push_back(std::move(x));
+    }
+    else {
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    }
+}
+
+json &json::emplace_back() {
+    if (!this->is_list())
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+    vector<json> &items = this->own_list().writable();
+    items.push_back(json());
+    return *items.back();
+}
+
+void json::reserve(std::size_t n) {
+    if (this->is_list())
+        this->own_list().items.reserve(n);
+    else
+        throw json_exception{"this is not a list", json_errc::wrong_type};
+}
+
+void json::insert(const std::pair<std::string, json> &x) {
+    this->insert(std::pair<std::string, json>(x));
+}
+
+void json::insert(std::pair<std::string, json> &&x) {
+    if (this->is_dictionary()) {
+        dictionary_storage &storage = this->own_dictionary();
+        if (arena::owns_heap(x.first) || arena::owns_heap(x.second))
+            storage.pure = false;
+        /* a repeated key overwrites the previous value in place */
+        if (auto entry = storage.find(x.first))
+            entry->second = std::move(x.second);
+        else
+            storage.append(std::move(x));
+    } else {
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    }
+}
+
+json &json::emplace(std::string key) {
+    if (!this->is_dictionary())
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    dictionary_storage &storage = this->own_dictionary().writable();
+    if (auto entry = storage.find(key)) {
+        entry->second.set_null();
+        return entry->second;
+    }
+    return storage.append(std::pair<std::string, json>(std::move(key), json())).second;
+}
+
+bool json::erase(std::string_view key) {
+    if (!this->is_dictionary())
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    dictionary_storage &storage = this->own_dictionary();
+    auto entry = storage.find(key);
+    if (entry == nullptr)
+        return false;
+    uint64_t pos = entry - storage.items.begin();
+    storage.erase(&pos, &pos + 1);
+    return true;
+}
+
+/* index of the lowest set bit, x != 0 */
+static int lowest_bit(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+/* Collects the output of the serializer straight into the characters
+   of a string, or into a block that is handed to a stream buffer every
+   time it fills up. */
+class writer {
+public:
+    static constexpr std::size_t block_size = 1 << 16;
+
+    /* appends to out */
+    explicit writer(std::string &out) : out(&out) {
+        this->cur = this->end = &out[0] + out.size();
+        this->grow(256);
+    }
+
+    explicit writer(std::streambuf &sb) : sb(&sb), block(new char[block_size]) {
+        this->cur = this->block.get();
+        this->end = this->cur + block_size;
+    }
+
+    writer(writer const &) = delete;
+
+    ~writer() {
+        this->flush();
+    }
+
+    writer &operator=(writer const &) = delete;
+
+    void put(char c) {
+        if (this->cur == this->end)
+            this->grow(1);
+        *this->cur++ = c;
+    }
+
+    void write(const char *p, std::size_t n) {
+        if (static_cast<std::size_t>(this->end - this->cur) < n) {
+            this->grow(n);
+            if (static_cast<std::size_t>(this->end - this->cur) < n) {
+                /* larger than a whole block, skip the copy */
+                this->put_blocks(p, n);
+                return;
+            }
+        }
+        std::memcpy(this->cur, p, n);
+        this->cur += n;
+    }
+
+    void write(std::string_view text) {
+        this->write(text.data(), text.size());
+    }
+
+    /* trims the string to what was written, or hands the block to the
+       stream buffer; false if the stream buffer failed */
+    bool flush() {
+        if (this->out != nullptr) {
+            std::size_t size = this->cur - &(*this->out)[0];
+            this->out->resize(size);
+            this->cur = this->end = &(*this->out)[0] + size;
+        } else {
+            this->put_blocks(this->block.get(), this->cur - this->block.get());
+            this->cur = this->block.get();
+        }
+        return this->good;
+    }
+
+private:
+    /* makes room for n more characters */
+    void grow(std::size_t n) {
+        if (this->out == nullptr) {
+            this->flush();
+            return;
+        }
+        char *base = &(*this->out)[0];
+        std::size_t size = this->cur - base;
+        std::size_t capacity = std::max(this->out->size() * 2, size + n);
+        this->out->resize(capacity);
+        base = &(*this->out)[0];
+        this->cur = base + size;
+        this->end = base + capacity;
+    }
+
+    void put_blocks(const char *p, std::size_t n) {
+        std::streamsize count = static_cast<std::streamsize>(n);
+        if (count != 0 && this->sb->sputn(p, count) != count)
+            this->good = false;
+    }
+
+    std::string *out = nullptr;
+    std::streambuf *sb = nullptr;
+    std::unique_ptr<char[]> block;
+    char *cur = nullptr;
+    char *end = nullptr;
+    bool good = true;
+};
+
+/* Length of the prefix of [p, p + n) that a json string can hold as it
+   is: anything but '"', '\\' and the control characters below 0x20.
+   ascii is cleared when a byte of the blocks read is 0x80 or above, so
+   it stays set only for a prefix that needs no UTF-8 check. */
+static std::size_t plain_prefix(const char *p, std::size_t n, bool &ascii) {
+    std::size_t i = 0;
+#if defined(JSON_USE_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    __m256i high = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        high = _mm256_or_si256(high, v);
+        /* v <= 0x1f unsigned exactly when max(v, 0x1f) == 0x1f */
+        __m256i special = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if (mask != 0) {
+            ascii = ascii && _mm256_movemask_epi8(high) == 0;
+            return i + lowest_bit(mask);
+        }
+    }
+    ascii = ascii && _mm256_movemask_epi8(high) == 0;
+#elif defined(JSON_USE_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    __m128i high = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        high = _mm_or_si128(high, v);
+        /* v <= 0x1f unsigned exactly when max(v, 0x1f) == 0x1f */
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            ascii = ascii && _mm_movemask_epi8(high) == 0;
+            return i + lowest_bit(mask);
+        }
+    }
+    ascii = ascii && _mm_movemask_epi8(high) == 0;
+#elif defined(JSON_USE_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    uint8x16_t high = vdupq_n_u8(0);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+        uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, control));
+        if (vmaxvq_u8(special) != 0)
+            break;  // the scalar loop finds which byte
+        high = vorrq_u8(high, v);
+    }
+    ascii = ascii && vmaxvq_u8(high) < 0x80;
+#endif
+    for (; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        if (c == '"' || c == '\\' || c < 0x20)
+            break;
+        if (c >= 0x80)
+            ascii = false;
+    }
+    return i;
+}
+
+static std::size_t plain_prefix(const char *p, std::size_t n) {
+    bool ascii = true;
+    return plain_prefix(p, n, ascii);
+}
+
+/* Writes json text, compact or indented by indent spaces per level. */
+class serializer {
+public:
+    serializer(writer &out, unsigned indent) : out(out), indent(indent) {}
+
+    void value(json const &j, unsigned depth) {
+        if (j.is_integer()) {
+            this->integer(j.get_integer());
+        } else if (j.is_number()) {
+            this->number(j.get_number());
+        } else if (j.is_string()) {
+            this->string(j.get_string_view());
+        } else if (j.is_list()) {
+            if (j.size() == 0) {
+                this->out.write("[]", 2);
+                return;
+            }
+            this->out.put('[');
+            bool first = true;
+            for (json::const_list_iterator it = j.begin_list(); it != j.end_list(); ++it) {
+                if (!first)
+                    this->out.put(',');
+                first = false;
+                this->newline(depth + 1);
+                this->value(*it, depth + 1);
+            }
+            this->newline(depth);
+            this->out.put(']');
+        } else if (j.is_dictionary()) {
+            if (j.size() == 0) {
+                this->out.write("{}", 2);
+                return;
+            }
+            this->out.put('{');
+            bool first = true;
+            for (json::const_dictionary_iterator it = j.begin_dictionary(); it != j.end_dictionary(); ++it) {
+                if (!first)
+                    this->out.put(',');
+                first = false;
+                this->newline(depth + 1);
+                this->string(it->first);
+                this->out.put(':');
+                if (this->indent != 0)
+                    this->out.put(' ');
+                this->value(it->second, depth + 1);
+            }
+            this->newline(depth);
+            this->out.put('}');
+        } else if (j.is_bool()) {
+            this->out.write(j.get_bool() ? std::string_view("true") : std::string_view("false"));
+        } else {
+            this->out.write("null", 4);
+        }
+    }
+
+private:
+    void newline(unsigned depth) {
+        if (this->indent == 0)
+            return;
+        this->out.put('\n');
+        for (unsigned i = depth * this->indent; i > 0; --i)
+            this->out.put(' ');
+    }
+
+    void integer(std::int64_t x) {
+        char buffer[24];
+#if defined(__cpp_lib_to_chars)
+        char *last = std::to_chars(buffer, buffer + sizeof(buffer), x).ptr;
+#else
+        char *last = buffer + std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(x));
+#endif
+        this->out.write(buffer, last - buffer);
+    }
+
+    /* the shortest text that reads back as the same double; json has no
+       infinities or NaN, so those become null */
+    void number(double x) {
+        if (!std::isfinite(x)) {
+            this->out.write("null", 4);
+            return;
+        }
+        char buffer[32];
+#if defined(__cpp_lib_to_chars)
+        char *last = std::to_chars(buffer, buffer + sizeof(buffer), x).ptr;
+#else
+        char *last = buffer + std::snprintf(buffer, sizeof(buffer), "%.17g", x);
+#endif
+        /* keep it a double when read back */
+        bool integral = true;
+        for (char *c = buffer; c != last; ++c)
+            if (*c == '.' || *c == 'e' || *c == 'n' || *c == 'i')
+                integral = false;
+        if (integral) {
+            *last++ = '.';
+            *last++ = '0';
+        }
+        this->out.write(buffer, last - buffer);
+    }
+
+    void string(std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        this->out.put('"');
+        const char *p = text.data();
+        std::size_t n = text.size();
+        while (n != 0) {
+            std::size_t plain = plain_prefix(p, n);
+            this->out.write(p, plain);
+            if (plain == n)
+                break;
+            unsigned char c = static_cast<unsigned char>(p[plain]);
+            char escape[6] = {'\\', 0, 0, 0, 0, 0};
+            std::size_t length = 2;
+            switch (c) {
+                case '"': escape[1] = '"'; break;
+                case '\\': escape[1] = '\\'; break;
+                case '\b': escape[1] = 'b'; break;
+                case '\f': escape[1] = 'f'; break;
+                case '\n': escape[1] = 'n'; break;
+                case '\r': escape[1] = 'r'; break;
+                case '\t': escape[1] = 't'; break;
+                default:
+                    escape[1] = 'u';
+                    escape[2] = '0';
+                    escape[3] = '0';
+                    escape[4] = hex[c >> 4];
+                    escape[5] = hex[c & 15];
+                    length = 6;
+            }
+            this->out.write(escape, length);
+            p += plain + 1;
+            n -= plain + 1;
+        }
+        this->out.put('"');
+    }
+
+    writer &out;
+    unsigned indent;
+};
+
+std::string json::dump(unsigned indent) const {
+    stat_timer timer(stat_id::dump_ns);
+    std::string out;
+    {
+        writer w(out);
+        serializer(w, indent).value(*this, 0);
+    }
+    return out;
+}
+
+void json::dump(std::ostream &out, unsigned indent) const {
+    stat_timer timer(stat_id::dump_ns);
+    std::ostream::sentry ok(out);
+    if (!ok)
+        return;
+    if (out.rdbuf() == nullptr) {
+        out.setstate(std::ios_base::badbit);
+        return;
+    }
+    writer w(*out.rdbuf());
+    serializer(w, indent).value(*this, 0);
+    if (!w.flush())
+        out.setstate(std::ios_base::badbit);
+}
+
+std::ostream &operator<<(std::ostream &lhs, json const &rhs) {
+    rhs.dump(lhs);
+    return lhs;
+}
+
+
+enum class TOKEN
+{
+    GRAFFA_APERTA = '{',
+    GRAFFA_CHIUSA = '}',
+    DUE_PUNTI = ':',
+    STRING = 's',
+    NUMBER = 'n',
+    QUADRA_APERTA = '[',
+    QUADRA_CHIUSA = ']',
+    VIRGOLA = ',',
+    BOOLEAN = 'b',
+    NULLO = '0',
+    FINE_INPUT = 'f',
+};
+
+struct Token
+{
+    std::string value;
+    /* for TOKEN::STRING from a contiguous input: the characters between
+       the quotes, left in place instead of being copied into value */
+    std::string_view raw;
+    TOKEN type;
+    /* set for TOKEN::NUMBER, integral tells which of the two is exact */
+    bool integral = false;
+    std::int64_t integer = 0;
+    double number = 0;
+    std::string toString();
+
+    /* the content of a TOKEN::STRING */
+    std::string_view text() const {
+        return raw.data() != nullptr ? raw : std::string_view(value);
+    }
+};
+
+/* one more token of type t for json::read_stats() */
+static void count_token(TOKEN t) {
+    switch (t) {
+        case TOKEN::GRAFFA_APERTA: count_stat(stat_id::open_brace); break;
+        case TOKEN::GRAFFA_CHIUSA: count_stat(stat_id::close_brace); break;
+        case TOKEN::QUADRA_APERTA: count_stat(stat_id::open_bracket); break;
+        case TOKEN::QUADRA_CHIUSA: count_stat(stat_id::close_bracket); break;
+        case TOKEN::DUE_PUNTI: count_stat(stat_id::colon); break;
+        case TOKEN::VIRGOLA: count_stat(stat_id::comma); break;
+        case TOKEN::STRING: count_stat(stat_id::string); break;
+        case TOKEN::NUMBER: count_stat(stat_id::number); break;
+        case TOKEN::BOOLEAN: count_stat(stat_id::boolean); break;
+        case TOKEN::NULLO: count_stat(stat_id::null); break;
+        case TOKEN::FINE_INPUT: break;
+    }
+}
+
+
+/*
+    Strings
+
+    The text between the quotes is decoded into what it stands for:
+    escape sequences are replaced, and control characters and malformed
+    UTF-8 are rejected. A string without escape sequences is its own
+    text, so a parser over a contiguous input gives out a view of it;
+    finding that out is the same block scan the serializer uses.
+*/
+
+[[noreturn]] static void invalid_string(const char *what) {
+    throw json_exception{what, json_errc::invalid_string};
+}
+
+/* Is [p, end) well formed UTF-8? The ranges of the second byte after
+   each lead byte rule out overlong forms, surrogates and code points
+   past U+10FFFF, as in table 3-7 of the Unicode standard. Branching
+   on the lead byte beats a table of lengths: the branches are
+   predicted, a lookup would delay every next sequence. */
+static bool valid_utf8(const char *p, const char *end) {
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(p);
+    const unsigned char *e = reinterpret_cast<const unsigned char *>(end);
+    auto continues = [](unsigned char c) { return (c & 0xc0) == 0x80; };
+    while (s != e) {
+        uint64_t word;
+        if (e - s >= 8 && (std::memcpy(&word, s, 8), (word & 0x8080808080808080u) == 0)) {
+            s += 8;
+            continue;
+        }
+        unsigned char c = *s;
+        if (c < 0x80) {
+            ++s;
+        } else if (c < 0xc2) {
+            return false;
+        } else if (c < 0xe0) {
+            if (e - s < 2 || !continues(s[1]))
+                return false;
+            s += 2;
+        } else if (c < 0xf0) {
+            unsigned char low = c == 0xe0 ? 0xa0 : 0x80;
+            unsigned char high = c == 0xed ? 0x9f : 0xbf;
+            if (e - s < 3 || s[1] < low || s[1] > high || !continues(s[2]))
+                return false;
+            s += 3;
+        } else if (c < 0xf5) {
+            unsigned char low = c == 0xf0 ? 0x90 : 0x80;
+            unsigned char high = c == 0xf4 ? 0x8f : 0xbf;
+            if (e - s < 4 || s[1] < low || s[1] > high || !continues(s[2]) || !continues(s[3]))
+                return false;
+            s += 4;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* the code unit of the 4 hex digits at p, -1 if they are not */
+static int32_t hex4(const char *p) {
+    int32_t code = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return -1;
+        code = code * 16 + digit;
+    }
+    return code;
+}
+
+/* Writes what the escape sequence at p, a backslash, stands for at out,
+   returning the character after it. A \u escape of a high surrogate
+   must go on with the one of a low surrogate, together they make one
+   code point. Nothing written is longer than the sequence. */
+static const char *unescape_one(const char *p, const char *end, char *&out) {
+    if (end - p < 2)
+        invalid_string("escape sequence cut by the end of the string");
+    switch (p[1]) {
+        case '"': *out++ = '"'; return p + 2;
+        case '\\': *out++ = '\\'; return p + 2;
+        case '/': *out++ = '/'; return p + 2;
+        case 'b': *out++ = '\b'; return p + 2;
+        case 'f': *out++ = '\f'; return p + 2;
+        case 'n': *out++ = '\n'; return p + 2;
+        case 'r': *out++ = '\r'; return p + 2;
+        case 't': *out++ = '\t'; return p + 2;
+        case 'u': break;
+        default: invalid_string("invalid escape sequence in a string");
+    }
+    int32_t unit = end - p >= 6 ? hex4(p + 2) : -1;
+    if (unit < 0)
+        invalid_string("invalid \\u escape in a string");
+    p += 6;
+    uint32_t code = static_cast<uint32_t>(unit);
+    if (code >= 0xd800 && code <= 0xdbff) {
+        int32_t low = end - p >= 6 && p[0] == '\\' && p[1] == 'u' ? hex4(p + 2) : -1;
+        if (low < 0xdc00 || low > 0xdfff)
+            invalid_string("unpaired surrogate in a \\u escape");
+        code = 0x10000 + ((code - 0xd800) << 10) + (static_cast<uint32_t>(low) - 0xdc00);
+        p += 6;
+    } else if (code >= 0xdc00 && code <= 0xdfff) {
+        invalid_string("unpaired surrogate in a \\u escape");
+    }
+    if (code < 0x80) {
+        *out++ = static_cast<char>(code);
+    } else if (code < 0x800) {
+        *out++ = static_cast<char>(0xc0 | (code >> 6));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        *out++ = static_cast<char>(0xe0 | (code >> 12));
+        *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        *out++ = static_cast<char>(0xf0 | (code >> 18));
+        *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (code & 0x3f));
+    }
+    return p;
+}
+
+/* Decodes the text between the quotes of a string, [p, end), to out,
+   returning its length. out has room for end - p characters and may be
+   p itself, the text never grows. */
+static std::size_t unescape(const char *p, const char *end, char *out) {
+    char *o = out;
+    bool counted = false;
+    while (true) {
+        bool ascii = true;
+        std::size_t plain = plain_prefix(p, end - p, ascii);
+        if (!ascii && !valid_utf8(p, p + plain))
+            invalid_string("invalid UTF-8 in a string");
+        if (o != p)
+            std::memmove(o, p, plain);
+        o += plain;
+        p += plain;
+        if (p == end)
+            return o - out;
+        if (*p != '\\')
+            invalid_string("control character in a string");
+        if (!counted) {
+            count_stat(stat_id::escaped_strings);
+            counted = true;
+        }
+        p = unescape_one(p, end, o);
+    }
+}
+
+/* The checks of unescape() on [p, end) without decoding anything: each
+   escape sequence goes to a scratch buffer, dropped right after. */
+static void check_string(const char *p, const char *end) {
+    char scratch[4];
+    bool counted = false;
+    while (true) {
+        bool ascii = true;
+        std::size_t plain = plain_prefix(p, end - p, ascii);
+        if (!ascii && !valid_utf8(p, p + plain))
+            invalid_string("invalid UTF-8 in a string");
+        p += plain;
+        if (p == end)
+            return;
+        if (*p != '\\')
+            invalid_string("control character in a string");
+        if (!counted) {
+            count_stat(stat_id::escaped_strings);
+            counted = true;
+        }
+        char *o = scratch;
+        p = unescape_one(p, end, o);
+    }
+}
+
+/* the text of a string whose characters between the quotes are raw:
+   raw itself without escape sequences, else decoded into buffer */
+static std::string_view unescape(std::string_view raw, std::string &buffer) {
+    bool ascii = true;
+    std::size_t plain = plain_prefix(raw.data(), raw.size(), ascii);
+    if (plain == raw.size()) {
+        if (!ascii && !valid_utf8(raw.data(), raw.data() + plain))
+            invalid_string("invalid UTF-8 in a string");
+        return raw;
+    }
+    buffer.resize(raw.size());
+    buffer.resize(unescape(raw.data(), raw.data() + raw.size(), &buffer[0]));
+    return buffer;
+}
+
+/* The closing quote of a string in [p, end), nullptr if the string goes
+   on past end. escaped carries a trailing backslash over to the next
+   chunk. */
+static const char *find_closing_quote(const char *p, const char *end, bool &escaped) {
+    while (true) {
+        if (escaped) {
+            if (p == end)
+                return nullptr;
+            ++p;
+            escaped = false;
+        }
+        const char *quote = static_cast<const char *>(std::memchr(p, '"', end - p));
+        const char *stop = quote != nullptr ? quote : end;
+        const char *backslash = static_cast<const char *>(std::memchr(p, '\\', stop - p));
+        if (backslash == nullptr)
+            return quote;
+        p = backslash + 1;
+        escaped = true;
+    }
+}
+
+
+/*
+    Structural index (stage 1)
+
+    A first pass over a contiguous input classifies 64 bytes at a time
+    into bitmasks (quotes, backslashes, operators and whitespace), works
+    out with pure bit arithmetic which quotes are escaped and which bytes
+    are inside strings, and records the position of every token start:
+    { } [ ] : , outside strings, opening quotes and the first byte of
+    each number or literal. The tokenizer then jumps from position to
+    position instead of testing every character. The parallel parser
+    uses it to split a list into slices; a serial parse does without,
+    the tokenizer still reading every scalar byte by byte.
+*/
+
+struct block_masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;          // { } [ ] : ,
+    uint64_t whitespace;  // space \t \n \r
+};
+
+#if defined(JSON_USE_AVX2)
+
+static block_masks classify_block(const char *p) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    auto eq = [&](__m256i a, __m256i b) -> uint64_t {
+        uint64_t l = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, a)));
+        uint64_t h = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, b)));
+        return l | (h << 32);
+    };
+    auto eq_char = [&](char c) {
+        __m256i v = _mm256_set1_epi8(c);
+        return eq(v, v);
+    };
+    /* '[' | 0x20 == '{' and ']' | 0x20 == '}' */
+    __m256i bit5 = _mm256_set1_epi8(0x20);
+    __m256i lo_folded = _mm256_or_si256(lo, bit5);
+    __m256i hi_folded = _mm256_or_si256(hi, bit5);
+    auto eq_folded = [&](char c) -> uint64_t {
+        __m256i v = _mm256_set1_epi8(c);
+        uint64_t l = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo_folded, v)));
+        uint64_t h = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi_folded, v)));
+        return l | (h << 32);
+    };
+    return {
+        eq_char('"'),
+        eq_char('\\'),
+        eq_folded('{') | eq_folded('}') | eq_char(':') | eq_char(','),
+        eq_char(' ') | eq_char('\t') | eq_char('\n') | eq_char('\r'),
+    };
+}
+
+#elif defined(JSON_USE_SSE2)
+
+static block_masks classify_block(const char *p) {
+    __m128i in[4], folded[4];
+    __m128i bit5 = _mm_set1_epi8(0x20);
+    for (int i = 0; i != 4; ++i) {
+        in[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+        folded[i] = _mm_or_si128(in[i], bit5);  // '[' -> '{', ']' -> '}'
+    }
+    auto eq = [](__m128i const *v, char c) {
+        __m128i x = _mm_set1_epi8(c);
+        uint64_t m = 0;
+        for (int i = 0; i != 4; ++i)
+            m |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], x)))) << (16 * i);
+        return m;
+    };
+    return {
+        eq(in, '"'),
+        eq(in, '\\'),
+        eq(folded, '{') | eq(folded, '}') | eq(in, ':') | eq(in, ','),
+        eq(in, ' ') | eq(in, '\t') | eq(in, '\n') | eq(in, '\r'),
+    };
+}
+
+#elif defined(JSON_USE_NEON)
+
+/* NEON has no movemask: weight every lane with its bit and add pairwise */
+static uint64_t neon_movemask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3) {
+    const uint8x16_t weights = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    uint8x16_t s0 = vpaddq_u8(vandq_u8(m0, weights), vandq_u8(m1, weights));
+    uint8x16_t s1 = vpaddq_u8(vandq_u8(m2, weights), vandq_u8(m3, weights));
+    s0 = vpaddq_u8(s0, s1);
+    s0 = vpaddq_u8(s0, s0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static block_masks classify_block(const char *p) {
+    uint8x16_t in[4], folded[4];
+    uint8x16_t bit5 = vdupq_n_u8(0x20);
+    for (int i = 0; i != 4; ++i) {
+        in[i] = vld1q_u8(reinterpret_cast<const uint8_t *>(p + 16 * i));
+        folded[i] = vorrq_u8(in[i], bit5);  // '[' -> '{', ']' -> '}'
+    }
+    auto eq = [](uint8x16_t const *v, char c) {
+        uint8x16_t x = vdupq_n_u8(static_cast<uint8_t>(c));
+        return neon_movemask(vceqq_u8(v[0], x), vceqq_u8(v[1], x), vceqq_u8(v[2], x), vceqq_u8(v[3], x));
+    };
+    return {
+        eq(in, '"'),
+        eq(in, '\\'),
+        eq(folded, '{') | eq(folded, '}') | eq(in, ':') | eq(in, ','),
+        eq(in, ' ') | eq(in, '\t') | eq(in, '\n') | eq(in, '\r'),
+    };
+}
+
+#else
+
+static block_masks classify_block(const char *p) {
+    block_masks m{0, 0, 0, 0};
+    for (int i = 0; i != 64; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (p[i]) {
+            case '"': m.quote |= bit; break;
+            case '\\': m.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': m.whitespace |= bit; break;
+            default: break;
+        }
+    }
+    return m;
+}
+
+#endif
+
+/* bit i of the result is the xor of bits 0..i of x */
+static uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/* Carries the state of the scan from one 64 byte block to the next. */
+class structural_scanner {
+public:
+    /* appends to out the token starts found in the 64 bytes at p,
+       base is the offset of p in the input */
+    void scan(const char *p, uint32_t base, vector<uint32_t> &out) {
+        block_masks m = classify_block(p);
+        uint64_t in_string;
+        uint64_t quote = this->strings(m, in_string);
+
+        uint64_t scalar = ~(m.op | m.whitespace | quote) & ~in_string;
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+
+        uint64_t starts = (m.op & ~in_string) | (quote & in_string) | scalar_start;
+
+        if (out.capacity() - out.size() < 64)
+            out.reserve(2 * out.capacity() + 64);
+        while (starts) {
+            out.push_back(base + lowest_bit(starts));
+            starts &= starts - 1;
+        }
+    }
+
+    /* Returns the quotes of the block m that are not escaped, and sets
+       in_string from each opening quote up to, not including, its
+       closing one. */
+    uint64_t strings(block_masks const &m, uint64_t &in_string) {
+        /* a character is escaped when it follows an odd run of backslashes:
+           runs starting on odd bits carry differently from runs starting
+           on even bits when added to the backslash mask */
+        uint64_t backslash = m.backslash & ~prev_escaped;
+        uint64_t follows_escape = (backslash << 1) | prev_escaped;
+        const uint64_t even_bits = 0x5555555555555555ULL;
+        uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+        uint64_t even_starts = odd_starts + backslash;
+        prev_escaped = even_starts < backslash;  // carry out of the block
+        uint64_t escaped = (even_bits ^ (even_starts << 1)) & follows_escape;
+        uint64_t quote = m.quote & ~escaped;
+
+        in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+        return quote;
+    }
+
+    /* the input ended inside a string */
+    bool unterminated() const {
+        return prev_in_string != 0;
+    }
+
+private:
+    uint64_t prev_escaped = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_scalar = 0;
+};
+
+/* below this size a list is not worth splitting across threads */
+static constexpr std::size_t structural_index_min_size = 4096;
+
+/* Positions of all the token starts of the input. Offsets are 32 bit, so
+   the index is only built for inputs smaller than 4 GiB. */
+static vector<uint32_t> build_structural_index(std::string_view input) {
+    stat_timer timer(stat_id::index_ns);
+    vector<uint32_t> index;
+    index.reserve(input.size() / 8 + 64);
+    structural_scanner scanner;
+    std::size_t full = input.size() & ~std::size_t(63);
+    for (std::size_t i = 0; i != full; i += 64)
+        scanner.scan(input.data() + i, static_cast<uint32_t>(i), index);
+    if (full != input.size()) {
+        char tail[64];
+        std::memset(tail, ' ', sizeof tail);
+        std::memcpy(tail, input.data() + full, input.size() - full);
+        scanner.scan(tail, static_cast<uint32_t>(full), index);
+    }
+    return index;
+}
+
+
+/* What a byte starts outside of strings: the tokenizers dispatch on
+   char_classes[byte] with one indexed jump instead of a chain of
+   comparisons. */
+enum class char_class : unsigned char {
+    invalid,
+    space,
+    quote,
+    open_brace,
+    close_brace,
+    open_bracket,
+    close_bracket,
+    colon,
+    comma,
+    number,  // - or a digit
+    false_literal,
+    true_literal,
+    null_literal,
+    letter,  // any other of a-z, only the start of an invalid literal
+};
+
+static constexpr std::array<char_class, 256> char_classes = [] {
+    std::array<char_class, 256> c{};
+    for (char s : {' ', '\n', '\t', '\r'})
+        c[static_cast<unsigned char>(s)] = char_class::space;
+    for (char l = 'a'; l <= 'z'; ++l)
+        c[static_cast<unsigned char>(l)] = char_class::letter;
+    for (char d = '0'; d <= '9'; ++d)
+        c[static_cast<unsigned char>(d)] = char_class::number;
+    c['-'] = char_class::number;
+    c['"'] = char_class::quote;
+    c['{'] = char_class::open_brace;
+    c['}'] = char_class::close_brace;
+    c['['] = char_class::open_bracket;
+    c[']'] = char_class::close_bracket;
+    c[':'] = char_class::colon;
+    c[','] = char_class::comma;
+    c['f'] = char_class::false_literal;
+    c['t'] = char_class::true_literal;
+    c['n'] = char_class::null_literal;
+    return c;
+}();
+
+static char_class class_of(char c) {
+    return char_classes[static_cast<unsigned char>(c)];
+}
+
+/* the characters that may appear in a json number */
+static constexpr std::array<bool, 256> number_chars = [] {
+    std::array<bool, 256> n{};
+    for (char c : {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '.', 'e', 'E', '+'})
+        n[static_cast<unsigned char>(c)] = true;
+    return n;
+}();
+
+static bool is_space(char c) {
+    return class_of(c) == char_class::space;
+}
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p != end && is_space(*p)) ++p;
+    return p;
+}
+
+/* past the closing quote of the string whose opening quote is at p */
+static const char *skip_string(const char *p, const char *end) {
+    const char *begin = ++p;
+    while (true) {
+        const char *quote = static_cast<const char *>(std::memchr(p, '"', end - p));
+        if (quote == nullptr)
+            throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+        const char *run = quote;
+        while (run != begin && run[-1] == '\\') --run;
+        p = quote + 1;
+        if ((quote - run) % 2 == 0)
+            return p;
+    }
+}
+
+/* Past the end of the value starting at p, only matching brackets and
+   quotes: what lies in between is not checked. A container is scanned
+   64 bytes at a time like for the structural index, only its brackets
+   outside strings being looked at one by one. */
+static const char *skip_value(const char *p, const char *end) {
+    if (p == end)
+        throw json_exception{"unexpected end of input", json_errc::unexpected_end};
+    switch (class_of(*p)) {
+        case char_class::quote:
+            return skip_string(p, end);
+        case char_class::open_brace:
+        case char_class::open_bracket: {
+            structural_scanner scanner;
+            std::size_t depth = 0;
+            char tail[64];
+            for (const char *q = p; q < end; q += 64) {
+                const char *block = q;
+                if (end - q < 64) {
+                    std::memset(tail, ' ', sizeof tail);
+                    std::memcpy(tail, q, end - q);
+                    block = tail;
+                }
+                block_masks m = classify_block(block);
+                uint64_t in_string;
+                scanner.strings(m, in_string);
+                for (uint64_t ops = m.op & ~in_string; ops != 0; ops &= ops - 1) {
+                    int i = lowest_bit(ops);
+                    char c = block[i];
+                    if (c == '{' || c == '[')
+                        ++depth;
+                    else if ((c == '}' || c == ']') && --depth == 0)
+                        return q + i + 1;
+                }
+            }
+            if (scanner.unterminated())
+                throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+            throw json_exception{"unexpected end of input", json_errc::unexpected_end};
+        }
+        default: {
+            const char *start = p;
+            while (p != end && !is_space(*p) && *p != ',' && *p != ']' && *p != '}') ++p;
+            if (p == start)
+                throw json_exception{std::string("carattere non identificato: ") + *p, json_errc::unexpected_character};
+            return p;
+        }
+    }
+}
+
+
+/* The tokenizer reads from a window [cur, last) of raw characters, so the
+   hot loops are plain pointer increments. The window either spans the
+   whole input (char range / string_view) or is a block-sized buffer that
+   is refilled from a std::streambuf when exhausted. */
+class Tokenizer{
+public:
+    char curr_char = ' ';
+    /* strings of the input are checked but not decoded, their tokens
+       left without text: json::validate() takes no memory */
+    bool check_only = false;
+
+    /* tokenizes the characters in [begin, end) */
+    Tokenizer(const char *begin, const char *end) : cur(begin), last(end), first(begin) {}
+
+    Tokenizer(std::string_view input) : Tokenizer(input.data(), input.data() + input.size()) {}
+
+    /* tokenizes the content of input, read buffer_size bytes at a time */
+    Tokenizer(std::streambuf &input) : sb(&input), buffer(new char[buffer_size]) {}
+
+    /* tokenizes input jumping straight to the token starts listed in index,
+       see build_structural_index() */
+    Tokenizer(std::string_view input, vector<uint32_t> &index)
+            : Tokenizer(input, index.begin(), index.end()) {}
+
+    /* only the tokens listed in [first, last) of a structural index */
+    Tokenizer(std::string_view input, const uint32_t *first, const uint32_t *last)
+            : Tokenizer(input) {
+        base = input.data();
+        next_start = first;
+        last_start = last;
+    }
+
+    Token get_token() {
+        Token token = read_token();
+        count_token(token.type);
+        return token;
+    }
+
+    /* gives e, unless it has one, the position of the last token read */
+    void locate(json_exception &e) const;
+
+    /* Moves past the container the last token opened, only matching
+       brackets and quotes, see skip_value(). False for a stream, which
+       cannot be jumped over. */
+    bool skip_container();
+
+private:
+    static constexpr std::size_t buffer_size = 1 << 16;
+
+    Token read_token();
+
+    /* loads the next block from the streambuf, false at the end of input */
+    bool refill();
+
+    /* is there at least one more character? */
+    bool more() {
+        return cur != last || refill();
+    }
+
+    /* consumes the characters of rest, throws if the input does not match */
+    void expect(const char *rest, const char *msg);
+
+    /* The index only has where a scalar starts: what follows one must
+       be a token start of the index too, else it is read as a token of
+       its own, as without an index, e.g. the x of [1x]. */
+    void end_scalar() {
+        if (base != nullptr && cur != last && !ends_scalar[static_cast<unsigned char>(*cur)])
+            unindexed = true;
+    }
+
+    static const std::array<bool, 256> ends_scalar;
+
+    const char *cur = nullptr;   // next character to read
+    const char *last = nullptr;  // one-past the last buffered character
+    const char *base = nullptr;  // input the structural index refers to
+    const uint32_t *next_start = nullptr;
+    const uint32_t *last_start = nullptr;
+    /* the next token starts at cur, where the index has no entry */
+    bool unindexed = false;
+    std::streambuf *sb = nullptr;
+    std::unique_ptr<char[]> buffer;
+    /* where the last token started, counted from the start of the input */
+    std::size_t token_offset = 0;
+    /* the input, or the part of the stream in the buffer */
+    const char *first = nullptr;
+    /* bytes and lines of the stream before the buffer, and where the
+       line going on in the buffer started */
+    std::size_t consumed = 0;
+    std::size_t lines = 0;
+    std::size_t line_begin = 0;
+};
+
+
+bool Tokenizer::refill() {
+    if (sb == nullptr)
+        return false;
+    if (first != nullptr) {
+        /* the lines of the block about to be dropped, for locate() */
+        for (const char *p = first; p != last && (p = static_cast<const char *>(std::memchr(p, '\n', last - p))) != nullptr; ++p) {
+            ++lines;
+            line_begin = consumed + (p - first) + 1;
+        }
+        consumed += last - first;
+    }
+    first = buffer.get();
+    std::streamsize n = sb->sgetn(buffer.get(), buffer_size);
+    if (n > 0)
+        count_stat(stat_id::bytes, n);
+    cur = buffer.get();
+    last = cur + (n > 0 ? n : 0);
+    return n > 0;
+}
+
+void Tokenizer::locate(json_exception &e) const {
+    if (e.line != 0)
+        return;
+    std::size_t line = lines;
+    std::size_t begin = line_begin;
+    if (first != nullptr && token_offset > consumed) {
+        const char *stop = first + std::min<std::size_t>(token_offset - consumed, last - first);
+        for (const char *p = first; p != stop && (p = static_cast<const char *>(std::memchr(p, '\n', stop - p))) != nullptr; ++p) {
+            ++line;
+            begin = consumed + (p - first) + 1;
+        }
+    }
+    e.offset = token_offset;
+    e.line = line + 1;
+    e.column = token_offset - std::min(begin, token_offset) + 1;
+}
+
+bool Tokenizer::skip_container() {
+    if (sb != nullptr)
+        return false;
+    cur = skip_value(cur - 1, last);
+    if (base != nullptr)
+        next_start = std::lower_bound(next_start, last_start, static_cast<uint32_t>(cur - base));
+    return true;
+}
+
+/* whitespace and the characters the structural index records */
+const std::array<bool, 256> Tokenizer::ends_scalar = [] {
+    std::array<bool, 256> e{};
+    for (char c : {' ', '\n', '\t', '\r', '"', '{', '}', '[', ']', ':', ','})
+        e[static_cast<unsigned char>(c)] = true;
+    return e;
+}();
+
+void Tokenizer::expect(const char *rest, const char *msg) {
+    for (; *rest; ++rest) {
+        if (!more() || *cur != *rest)
+            throw json_exception{msg, json_errc::invalid_literal};
+        ++cur;
+    }
+}
+
+/* any character that may appear in a json number */
+static bool is_number_char(char c) {
+    return number_chars[static_cast<unsigned char>(c)];
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* powers of ten that are exact in a double */
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* Parses the json number -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+   spanning exactly [p, end) into token. Integers that fit are kept exact
+   in 64 bit; other numbers with at most 19 digits and a small exponent
+   are one exact multiplication or division away, anything else goes
+   through the correctly rounded std::from_chars. */
+static bool parse_number(const char *p, const char *end, Token &token) {
+    const char *start = p;
+    bool negative = p != end && *p == '-';
+    if (negative) ++p;
+    if (p == end || !is_digit(*p))
+        return false;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    if (*p == '0') {
+        ++p;
+    } else {
+        for (; p != end && is_digit(*p); ++p, ++digits)
+            mantissa = mantissa * 10 + (*p - '0');
+    }
+
+    bool integral = true;
+    int64_t exponent = 0;
+    if (p != end && *p == '.') {
+        integral = false;
+        const char *fraction = ++p;
+        for (; p != end && is_digit(*p); ++p, ++digits)
+            mantissa = mantissa * 10 + (*p - '0');
+        if (p == fraction)
+            return false;
+        exponent = -(p - fraction);
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        integral = false;
+        ++p;
+        bool negative_exponent = p != end && *p == '-';
+        if (p != end && (*p == '-' || *p == '+')) ++p;
+        if (p == end || !is_digit(*p))
+            return false;
+        int64_t e = 0;
+        for (; p != end && is_digit(*p); ++p)
+            if (e < 100000) e = e * 10 + (*p - '0');
+        exponent += negative_exponent ? -e : e;
+    }
+    if (p != end)
+        return false;
+
+    token.integral = false;
+    if (digits <= 19) {
+        /* -0 stays a double, an integer has no sign of its own */
+        if (integral && mantissa <= uint64_t(INT64_MAX) + negative && (mantissa != 0 || !negative)) {
+            token.integral = true;
+            token.integer = negative ? static_cast<int64_t>(0 - mantissa) : static_cast<int64_t>(mantissa);
+            token.number = static_cast<double>(token.integer);
+            return true;
+        }
+        if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            double x = static_cast<double>(mantissa);
+            x = exponent < 0 ? x / exact_powers_of_ten[-exponent] : x * exact_powers_of_ten[exponent];
+            token.number = negative ? -x : x;
+            return true;
+        }
+    }
+    count_stat(stat_id::slow_numbers);
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result r = std::from_chars(start, end, token.number);
+    if (r.ec == std::errc::result_out_of_range) {
+        /* from_chars leaves the value untouched, saturate like strtod */
+        double x = exponent < 0 ? 0.0 : HUGE_VAL;
+        token.number = negative ? -x : x;
+    }
+    return r.ptr == end;
+#else
+    std::string copy(start, end);
+    token.number = std::strtod(copy.c_str(), nullptr);
+    return true;
+#endif
+}
+
+Token Tokenizer::read_token() {
+    struct Token token;
+
+    if (base != nullptr) {
+        /* the structural index already knows where the next token starts */
+        if (unindexed) {
+            unindexed = false;
+        } else {
+            if (next_start == last_start) {
+                token_offset = cur - base;
+                token.type = TOKEN::FINE_INPUT;
+                return token;
+            }
+            cur = base + *next_start++;
+        }
+        curr_char = *cur++;
+    } else {
+        /* skip the whitespace */
+        do {
+            if (!more()) {
+                token_offset = consumed + (cur - first);
+                token.type = TOKEN::FINE_INPUT;
+                return token;
+            }
+            curr_char = *cur++;
+        } while (class_of(curr_char) == char_class::space);
+    }
+    token_offset = consumed + (cur - 1 - first);
+
+    switch (class_of(curr_char)) {
+        case char_class::quote: {
+            token.type = TOKEN::STRING;
+            if (sb == nullptr) {
+                /* the whole string is in the buffer: when the block scan
+                   stops at its closing quote it is its own text, else it
+                   is decoded up to the quote that ends it */
+                const char *begin = cur;
+                bool ascii = true;
+                const char *stop = cur + plain_prefix(cur, last - cur, ascii);
+                if (stop != last && *stop == '"') {
+                    if (!ascii && !valid_utf8(begin, stop))
+                        invalid_string("invalid UTF-8 in a string");
+                    token.raw = std::string_view(begin, stop - begin);
+                    cur = stop + 1;
+                    return token;
+                }
+                bool escaped = false;
+                const char *quote = find_closing_quote(stop, last, escaped);
+                if (quote == nullptr)
+                    throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+                cur = quote + 1;
+                if (check_only) {
+                    check_string(begin, quote);
+                    return token;
+                }
+                token.value.resize(quote - begin);
+                token.value.resize(unescape(begin, quote, &token.value[0]));
+                return token;
+            }
+            /* copy whole runs of characters up to the closing quote, where
+               an escaped quote does not end the string, then decode them
+               in place */
+            const char *quote = nullptr;
+            while (true) {
+                if (quote == nullptr) {
+                    if (!more())
+                        throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+                    quote = static_cast<const char *>(std::memchr(cur, '"', last - cur));
+                }
+                const char *stop = quote != nullptr ? quote : last;
+                const char *backslash = static_cast<const char *>(std::memchr(cur, '\\', stop - cur));
+                if (backslash != nullptr) {
+                    token.value.append(cur, backslash + 1);
+                    cur = backslash + 1;
+                    if (!more())
+                        throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+                    if (cur == quote)
+                        quote = nullptr;  // that quote was escaped, look for the next one
+                    token.value += *cur++;
+                    continue;
+                }
+                if (quote != nullptr) {
+                    token.value.append(cur, quote);
+                    cur = quote + 1;
+                    break;
+                }
+                token.value.append(cur, last);
+                cur = last;
+            }
+            token.value.resize(unescape(token.value.data(), token.value.data() + token.value.size(), &token.value[0]));
+            break;
+        }
+        case char_class::open_brace:
+            token.type = TOKEN::GRAFFA_APERTA;
+            break;
+        case char_class::close_brace:
+            token.type = TOKEN::GRAFFA_CHIUSA;
+            break;
+        case char_class::number: {
+            token.type = TOKEN::NUMBER;
+            const char *start = cur - 1;
+            const char *p = cur;
+            while (p != last && is_number_char(*p)) ++p;
+            cur = p;
+            bool valid;
+            if (p == last && sb != nullptr) {
+                /* the number may go on in the next block, collect it first */
+                token.value.assign(start, p);
+                while (more()) {
+                    p = cur;
+                    while (p != last && is_number_char(*p)) ++p;
+                    token.value.append(cur, p);
+                    bool done = p != last;
+                    cur = p;
+                    if (done) break;
+                }
+                valid = parse_number(token.value.data(), token.value.data() + token.value.size(), token);
+                token.value.clear();
+            } else {
+                valid = parse_number(start, p, token);
+            }
+            if (!valid)
+                throw json_exception{"numero non valido", json_errc::invalid_number};
+            end_scalar();
+            break;
+        }
+        case char_class::false_literal:
+            token.type = TOKEN::BOOLEAN;
+            token.value = "False";
+            expect("alse", "boolean not valid");
+            end_scalar();
+            break;
+        case char_class::true_literal:
+            token.type = TOKEN::BOOLEAN;
+            token.value = "True";
+            expect("rue", "boolean not valid");
+            end_scalar();
+            break;
+        case char_class::null_literal:
+            token.type = TOKEN::NULLO;
+            expect("ull", "null not valid");
+            end_scalar();
+            break;
+        case char_class::open_bracket:
+            token.type = TOKEN::QUADRA_APERTA;
+            break;
+        case char_class::close_bracket:
+            token.type = TOKEN::QUADRA_CHIUSA;
+            break;
+        case char_class::colon:
+            token.type = TOKEN::DUE_PUNTI;
+            break;
+        case char_class::comma:
+            token.type = TOKEN::VIRGOLA;
+            break;
+        default:
+            throw json_exception{std::string("carattere non identificato: ") + curr_char, json_errc::unexpected_character};
+    }
+    return token;
+}
+
+
+/* Builds values on behalf of the parser: containers and long strings go
+   to the arena of the tokenizer if it has one. */
+struct json_builder {
+    static void set_list(json &j, json::arena *a) {
+        if (a == nullptr) {
+            j.set_list();
+            return;
+        }
+        void *p = a->allocate(sizeof(json::list_storage), alignof(json::list_storage));
+        json::list_storage *storage = new(p) json::list_storage(a);
+        j.destroy();
+        j.l = storage;
+        j.tag = json::kind::list;
+    }
+
+    static void set_dictionary(json &j, json::arena *a) {
+        if (a == nullptr) {
+            j.set_dictionary();
+            return;
+        }
+        void *p = a->allocate(sizeof(json::dictionary_storage), alignof(json::dictionary_storage));
+        json::dictionary_storage *storage = new(p) json::dictionary_storage(a);
+        j.destroy();
+        j.dict = storage;
+        j.tag = json::kind::dictionary;
+    }
+
+    using dictionary = json::dictionary_storage;
+
+    static dictionary &entries(json const &dictionary) {
+        return *dictionary.dict;
+    }
+
+    /* the entries to look into, ready to be changed for a non-const j */
+    static dictionary &entries_for(json const &dictionary) {
+        return *dictionary.dict;
+    }
+
+    static dictionary &entries_for(json &dictionary) {
+        return dictionary.own_dictionary().writable();
+    }
+
+    /* the entries, copied first if shared, to be changed in place by
+       code that hands out no reference to them */
+    static dictionary &own_entries(json &dictionary) {
+        return dictionary.own_dictionary();
+    }
+
+    /* do a and b share the storage of one list or dictionary? */
+    static bool same_storage(json const &a, json const &b) {
+        if (a.tag != b.tag)
+            return false;
+        if (a.is_list())
+            return a.l == b.l;
+        return a.is_dictionary() && a.dict == b.dict;
+    }
+
+    /* the elements of a list, bypassing the checks of the public API */
+    static vector<json> &items(json &list) {
+        return list.l->items;
+    }
+
+    /* strings short enough for the std::string inline buffer are always
+       copied, longer ones point into the input when it is pinned */
+    static void set_string(json &j, std::string_view text, json::arena *a, bool pinned) {
+        static const std::size_t inline_capacity = std::string().capacity();
+        if (pinned && text.size() > inline_capacity) {
+            j.destroy();
+            new(&j.ref) json::string_ref_data{text.data(), text.size(), a, {nullptr}};
+            j.tag = json::kind::string_ref;
+        } else {
+            j.destroy();
+            new(&j.s) std::string(text);
+            j.tag = json::kind::string;
+            if (text.size() > inline_capacity)
+                count_allocation(text.size() + 1);
+        }
+    }
+};
+
+
+/* The handler behind the tree parsers: an open container waits on a
+   stack until its closing bracket, then moves into its parent. */
+class tree_builder {
+public:
+    /* containers go to a, nullptr for the heap; pinned is the input when
+       it outlives the tree, so strings may point into it */
+    tree_builder(json::arena *a, std::string_view pinned) : a(a), pinned(pinned) {}
+
+    void on_null() {
+        this->add(json());
+    }
+
+    void on_boolean(bool value) {
+        json j;
+        j.set_bool(value);
+        this->add(std::move(j));
+    }
+
+    void on_number(double value) {
+        json j;
+        j.set_number(value);
+        this->add(std::move(j));
+    }
+
+    void on_integer(std::int64_t value) {
+        json j;
+        j.set_integer(value);
+        this->add(std::move(j));
+    }
+
+    void on_string(std::string_view text) {
+        json j;
+        json_builder::set_string(j, text, this->a, this->in_place(text));
+        this->add(std::move(j));
+    }
+
+    void on_key(std::string_view key) {
+        std::string &k = this->open.back()->key;
+        if (key.size() > k.capacity())
+            count_allocation(key.size() + 1);
+        k.assign(key.data(), key.size());
+    }
+
+    void on_start_object() {
+        std::size_t depth = this->open.size();
+        this->open.push_back(frame());
+        frame &f = *this->open.back();
+        json_builder::set_dictionary(f.value, this->a);
+        if (this->a != nullptr && depth < this->shapes.size() && this->shapes[depth] != nullptr) {
+            f.shape = this->shapes[depth];
+            /* most likely the same number of keys too */
+            json_builder::entries(f.value).items.reserve(f.shape->items.size());
+        }
+    }
+
+    void on_end_object() {
+        std::size_t depth = this->open.size() - 1;
+        frame &f = *this->open.back();
+        if (this->a != nullptr) {
+            json_builder::dictionary &d = json_builder::entries(f.value);
+            if (f.shape != nullptr && d.items.size() == f.shape->items.size())
+                d.share_index(*f.shape);
+            else if (f.shape != nullptr)
+                d.reindex();
+            while (this->shapes.size() <= depth)
+                this->shapes.push_back(nullptr);
+            this->shapes[depth] = &d;
+        }
+        this->close();
+    }
+
+    void on_start_array() {
+        this->open.push_back(frame());
+        json_builder::set_list(this->open.back()->value, this->a);
+    }
+
+    void on_end_array() {
+        this->close();
+    }
+
+    /* is there a complete top level value? */
+    bool done() const {
+        return this->complete;
+    }
+
+    /* the last complete top level value */
+    json &root() {
+        return this->result;
+    }
+
+private:
+    struct frame {
+        json value;
+        /* the key the next value of a dictionary goes to */
+        std::string key;
+        /* the previous dictionary at this depth, as long as the keys so
+           far are the same as its own */
+        json_builder::dictionary *shape = nullptr;
+    };
+
+    void add(json &&v) {
+        if (this->open.empty()) {
+            this->result = std::move(v);
+            this->complete = true;
+            return;
+        }
+        frame &f = *this->open.back();
+        if (f.value.is_list()) {
+            f.value.push_back(std::move(v));
+            return;
+        }
+        if (f.shape != nullptr) {
+            /* the keys of shape are distinct, so a key in the same place
+               as in shape cannot be a repeated one */
+            json_builder::dictionary &d = json_builder::entries(f.value);
+            std::size_t pos = d.items.size();
+            if (pos < f.shape->items.size() && f.shape->items[pos].first == f.key) {
+                if (json::arena::owns_heap(f.key) || json::arena::owns_heap(v))
+                    d.pure = false;
+                d.append_unindexed({std::move(f.key), std::move(v)});
+                return;
+            }
+            f.shape = nullptr;
+            d.reindex();
+        }
+        std::size_t size = f.value.size();
+        f.value.insert({std::move(f.key), std::move(v)});
+        if (f.value.size() == size) {
+            /* a repeated key destroyed the value it had, and with it the
+               dictionaries in it that shapes may point to */
+            while (this->shapes.size() > this->open.size())
+                this->shapes.pop_back();
+        }
+    }
+
+    void close() {
+        json v = std::move(this->open.back()->value);
+        this->open.pop_back();
+        this->add(std::move(v));
+    }
+
+    /* Can a string of this text point to it? Only inside pinned: a string
+       decoded from escape sequences is copied to the arena first. */
+    bool in_place(std::string_view &text) {
+        if (this->pinned.empty())
+            return false;
+        auto at = reinterpret_cast<std::uintptr_t>(text.data());
+        auto begin = reinterpret_cast<std::uintptr_t>(this->pinned.data());
+        if (at >= begin && at - begin <= this->pinned.size())
+            return true;
+        if (text.size() <= std::string().capacity())
+            return false;  // held inline anyway
+        char *copy = static_cast<char *>(this->a->allocate(text.size(), 1));
+        std::memcpy(copy, text.data(), text.size());
+        text = std::string_view(copy, text.size());
+        return true;
+    }
+
+    json::arena *a;
+    std::string_view pinned;
+    vector<frame> open;
+    /* the last dictionary completed at every depth */
+    vector<json_builder::dictionary *> shapes;
+    json result;
+    bool complete = false;
+};
+
+
+template<class Handler>
+void get_json_string(Token &token, Handler &h) {
+    h.on_string(token.text());
+}
+
+template<class Handler>
+void get_json_number(Token &t, Handler &h) {
+    if (t.integral)
+        h.on_integer(t.integer);
+    else
+        h.on_number(t.number);
+}
+
+template<class Handler>
+void get_json_boolean(Token &t, Handler &h) {
+    h.on_boolean(t.value == "True");
+}
+
+template<class Handler>
+void get_json_null(Token &, Handler &h) {
+    h.on_null();
+}
+
+/* the deepest nesting of containers the parsers accept */
+static std::atomic<std::size_t> max_nesting{1024};
+
+void json::set_max_depth(std::size_t depth) {
+    max_nesting.store(depth, std::memory_order_relaxed);
+}
+
+std::size_t json::max_depth() {
+    return max_nesting.load(std::memory_order_relaxed);
+}
+
+static json_exception too_deep() {
+    return json_exception{"containers nested deeper than json::max_depth()", json_errc::too_deep};
+}
+
+/*
+    Grammar
+
+    All the parsers run the same state machine. The state of the
+    innermost open container and the symbol of the next token index a
+    table telling what the token does and what state follows, so a
+    token costs one lookup instead of a branch per flag. The table
+    keeps the grammar of the parser: a comma may trail the elements
+    ([1,]) or stand alone in an empty container ([,]), booleans are
+    keys too, and numbers, null and brackets where a key should be are
+    skipped, as are a key without a value ({"a":}) and a colon after a
+    member ({"a":1:}). Each step also tells what a strict reader does
+    instead, json::validate() holding the text to RFC 8259: an error at
+    every step that is only there to be lenient.
+*/
+enum class grammar_symbol : unsigned char {
+    name,    // a string or a boolean: a value or a key
+    scalar,  // a number or null
+    open,    // { or [
+    colon,
+    comma,
+    close_list,
+    close_dictionary,
+    end,
+    count,
+};
+
+/* where the innermost container is, shown by an input ending there */
+enum class grammar_state : unsigned char {
+    document,             // before the value
+    done,                 // after it
+    list_first,           // [
+    list_element,         // [1
+    list_next,            // [1,
+    list_stray,           // [,
+    object_key,           // {
+    object_colon,         // {"a"
+    object_value,         // {"a":
+    object_member,        // {"a":1
+    object_member_colon,  // {"a":1:
+    object_next_key,      // {"a":1,
+    object_next_colon,    // {"a":1,"b"
+    object_next_value,    // {"a":1,"b":
+    object_stray_key,     // {,
+    object_stray_colon,   // {,"a"
+    object_stray_value,   // {,"a":
+    count,
+};
+
+enum class grammar_action : unsigned char {
+    element,  // the token is a value: of a list, or the document
+    member,   // the token is the value of the key read before
+    key,      // the token is the key of the next member
+    shift,    // only the state changes
+    skip,     // the token is ignored
+    close,    // the innermost container is over
+    /* the errors, in the order of grammar_error() */
+    misplaced_comma,
+    extra_comma,
+    missing_colon,
+    invalid,
+    trailing,
+};
+
+struct grammar_step {
+    grammar_action action;
+    grammar_state next;
+    grammar_action strict;  // the action of a strict reader
+};
+
+#define GO(action, state) grammar_step{grammar_action::action, grammar_state::state, grammar_action::action}
+#define DO(action) grammar_step{grammar_action::action, grammar_state::done, grammar_action::action}
+/* a lenient step, the strict reader stops with error */
+#define LAX(action, state, error) grammar_step{grammar_action::action, grammar_state::state, grammar_action::error}
+
+/* grammar[state][symbol], the columns in the order of grammar_symbol:
+   name, scalar, open, colon, comma, close_list, close_dictionary, end */
+static constexpr grammar_step grammar[static_cast<int>(grammar_state::count)][static_cast<int>(grammar_symbol::count)] = {
+    /* document */
+    {GO(element, done), GO(element, done), GO(element, done), DO(invalid),
+     DO(invalid), DO(invalid), DO(invalid), DO(invalid)},
+    /* done */
+    {DO(trailing), DO(trailing), DO(trailing), DO(trailing),
+     DO(trailing), DO(trailing), DO(trailing), DO(trailing)},
+    /* list_first */
+    {GO(element, list_element), GO(element, list_element), GO(element, list_element), DO(invalid),
+     LAX(shift, list_stray, misplaced_comma), DO(close), DO(invalid), DO(invalid)},
+    /* list_element */
+    {DO(misplaced_comma), DO(misplaced_comma), DO(misplaced_comma), DO(invalid),
+     GO(shift, list_next), DO(close), DO(invalid), DO(invalid)},
+    /* list_next */
+    {GO(element, list_element), GO(element, list_element), GO(element, list_element), DO(invalid),
+     DO(extra_comma), LAX(close, done, extra_comma), DO(invalid), DO(invalid)},
+    /* list_stray: like object_member_colon and the object_stray states,
+       only reached by lenient steps */
+    {DO(misplaced_comma), DO(misplaced_comma), DO(misplaced_comma), DO(invalid),
+     DO(extra_comma), DO(close), DO(invalid), DO(invalid)},
+    /* object_key */
+    {GO(key, object_colon), LAX(skip, object_key, invalid), LAX(skip, object_key, invalid), DO(invalid),
+     LAX(shift, object_stray_key, misplaced_comma), DO(invalid), DO(close), DO(invalid)},
+    /* object_colon */
+    {DO(missing_colon), DO(missing_colon), DO(missing_colon), GO(shift, object_value),
+     LAX(shift, object_stray_key, missing_colon), DO(invalid), LAX(close, done, missing_colon), DO(invalid)},
+    /* object_value */
+    {GO(member, object_member), GO(member, object_member), GO(member, object_member), DO(invalid),
+     LAX(shift, object_stray_key, invalid), DO(invalid), LAX(close, done, invalid), DO(invalid)},
+    /* object_member */
+    {DO(missing_colon), DO(missing_colon), DO(missing_colon), LAX(shift, object_member_colon, invalid),
+     GO(shift, object_next_key), DO(invalid), DO(close), DO(invalid)},
+    /* object_member_colon */
+    {DO(misplaced_comma), DO(misplaced_comma), DO(misplaced_comma), DO(invalid),
+     GO(shift, object_next_key), DO(invalid), DO(close), DO(invalid)},
+    /* object_next_key */
+    {GO(key, object_next_colon), LAX(skip, object_next_key, invalid), LAX(skip, object_next_key, invalid), DO(invalid),
+     DO(extra_comma), DO(invalid), LAX(close, done, extra_comma), DO(invalid)},
+    /* object_next_colon */
+    {DO(missing_colon), DO(missing_colon), DO(missing_colon), GO(shift, object_next_value),
+     DO(extra_comma), DO(invalid), LAX(close, done, missing_colon), DO(invalid)},
+    /* object_next_value */
+    {GO(member, object_member), GO(member, object_member), GO(member, object_member), DO(invalid),
+     DO(extra_comma), DO(invalid), LAX(close, done, invalid), DO(invalid)},
+    /* object_stray_key */
+    {GO(key, object_stray_colon), GO(skip, object_stray_key), GO(skip, object_stray_key), DO(invalid),
+     DO(extra_comma), DO(invalid), DO(close), DO(invalid)},
+    /* object_stray_colon */
+    {DO(missing_colon), DO(missing_colon), DO(missing_colon), GO(shift, object_stray_value),
+     DO(extra_comma), DO(invalid), DO(close), DO(invalid)},
+    /* object_stray_value */
+    {DO(misplaced_comma), DO(misplaced_comma), DO(misplaced_comma), DO(invalid),
+     DO(extra_comma), DO(invalid), DO(close), DO(invalid)},
+};
+
+#undef GO
+#undef DO
+#undef LAX
+
+static json_exception grammar_error(grammar_action a, grammar_symbol symbol) {
+    switch (a) {
+        case grammar_action::misplaced_comma:
+            return json_exception{"problema virgola", json_errc::unexpected_token};
+        case grammar_action::extra_comma:
+            return json_exception{"hai ricevuto una virgola non necessaria", json_errc::unexpected_token};
+        case grammar_action::missing_colon:
+            return json_exception{"due punti mancanti", json_errc::unexpected_token};
+        case grammar_action::trailing:
+            return json_exception{"unexpected characters after the json value", json_errc::trailing_characters};
+        default:
+            if (symbol == grammar_symbol::end)
+                return json_exception{"unexpected end of input", json_errc::unexpected_end};
+            return json_exception{"formato json non valido", json_errc::unexpected_token};
+    }
+}
+
+/* moves s on over symbol, returns what the token does or throws */
+static grammar_action advance(grammar_state &s, grammar_symbol symbol, bool strict = false) {
+    grammar_step step = grammar[static_cast<int>(s)][static_cast<int>(symbol)];
+    grammar_action action = strict ? step.strict : step.action;
+    if (action >= grammar_action::misplaced_comma)
+        throw grammar_error(action, symbol);
+    s = step.next;
+    return action;
+}
+
+/* The states of the open containers: as many levels as the default
+   json::max_depth() are kept in place, so only a raised limit can make
+   a parse allocate for its nesting. */
+class grammar_stack {
+public:
+    grammar_stack() : data(this->shallow) {}
+    grammar_stack(grammar_stack const &) = delete;
+    grammar_stack &operator=(grammar_stack const &) = delete;
+
+    bool empty() const {
+        return this->n == 0;
+    }
+
+    std::size_t size() const {
+        return this->n;
+    }
+
+    grammar_state &back() {
+        return this->data[this->n - 1];
+    }
+
+    void push(grammar_state s) {
+        if (this->n == this->capacity) {
+            std::unique_ptr<grammar_state[]> bigger(new grammar_state[2 * this->capacity]);
+            count_allocation(2 * this->capacity);
+            std::memcpy(bigger.get(), this->data, this->n);
+            this->deep = std::move(bigger);
+            this->data = this->deep.get();
+            this->capacity *= 2;
+        }
+        this->data[this->n++] = s;
+    }
+
+    void pop() {
+        --this->n;
+    }
+
+private:
+    grammar_state shallow[1024];
+    std::unique_ptr<grammar_state[]> deep;
+    grammar_state *data;
+    std::size_t n = 0;
+    std::size_t capacity = 1024;
+};
+
+/* strict, a boolean is no key */
+static grammar_symbol symbol_of(Token const &token, bool strict = false) {
+    switch (token.type) {
+        case TOKEN::STRING:
+            return grammar_symbol::name;
+        case TOKEN::BOOLEAN:
+            return strict ? grammar_symbol::scalar : grammar_symbol::name;
+        case TOKEN::NUMBER:
+        case TOKEN::NULLO:
+            return grammar_symbol::scalar;
+        case TOKEN::GRAFFA_APERTA:
+        case TOKEN::QUADRA_APERTA:
+            return grammar_symbol::open;
+        case TOKEN::DUE_PUNTI:
+            return grammar_symbol::colon;
+        case TOKEN::VIRGOLA:
+            return grammar_symbol::comma;
+        case TOKEN::QUADRA_CHIUSA:
+            return grammar_symbol::close_list;
+        case TOKEN::GRAFFA_CHIUSA:
+            return grammar_symbol::close_dictionary;
+        default:
+            return grammar_symbol::end;
+    }
+}
+
+/* A handler may have a bool skip_member(), asked after every key: true
+   means it has no use for the value, which is then skipped over rather
+   than reported. */
+template<class Handler, class = void>
+struct skips_members : std::false_type {};
+
+template<class Handler>
+struct skips_members<Handler, std::void_t<decltype(std::declval<Handler &>().skip_member())>> : std::true_type {};
+
+/* A handler whose static constexpr bool strict is true holds the text
+   to RFC 8259, taking the strict action of every grammar step. */
+template<class Handler, class = void>
+struct strict_grammar : std::false_type {};
+
+template<class Handler>
+struct strict_grammar<Handler, std::enable_if_t<Handler::strict>> : std::true_type {};
+
+template<class Handler>
+void get_json_value(Token &token, Tokenizer &t, Handler &h, std::size_t depth = 0);
+
+/* counts the values and their nesting, reporting nothing */
+template<bool Strict>
+class validator {
+public:
+    static constexpr bool strict = Strict;
+
+    void on_null() { ++this->result.values; }
+    void on_boolean(bool) { ++this->result.values; }
+    void on_number(double) { ++this->result.values; }
+    void on_integer(std::int64_t) { ++this->result.values; }
+    void on_string(std::string_view) { ++this->result.values; }
+    void on_key(std::string_view) {}
+    void on_start_object() { this->open(); }
+    void on_end_object() { --this->depth; }
+    void on_start_array() { this->open(); }
+    void on_end_array() { --this->depth; }
+
+    json::validation result;
+
+private:
+    void open() {
+        ++this->result.values;
+        if (++this->depth > this->result.depth)
+            this->result.depth = this->depth;
+    }
+
+    std::size_t depth = 0;
+};
+
+/* Consumes the value starting with token without reporting it: the
+   Tokenizer jumps over a container when it can, else it is checked
+   like by json::validate(). */
+static void skip_value(Token &token, Tokenizer &t) {
+    if (token.type != TOKEN::GRAFFA_APERTA && token.type != TOKEN::QUADRA_APERTA)
+        return;
+    if (!t.skip_container()) {
+        validator<false> v;
+        get_json_value(token, t, v);
+    }
+}
+
+/* Reports the value starting with token to h, reading the rest from t.
+   The open containers wait on an explicit stack rather than on the
+   call stack, so the stack use is the same for any nesting, and the
+   nesting is limited to json::max_depth(), depth containers being
+   open around the value already. */
+template<class Handler>
+void get_json_value(Token &token, Tokenizer &t, Handler &h, std::size_t depth) {
+    constexpr bool strict = strict_grammar<Handler>::value;
+    std::size_t limit = json::max_depth() - std::min(depth, json::max_depth());
+    grammar_stack open;
+    /* the key of the member being read, a string or a boolean */
+    Token key;
+
+    /* reports a scalar, or opens a container */
+    auto begin_value = [&](Token &v) {
+        switch (v.type) {
+            case TOKEN::GRAFFA_APERTA:
+                if (open.size() >= limit)
+                    throw too_deep();
+                open.push(grammar_state::object_key);
+                h.on_start_object();
+                break;
+            case TOKEN::QUADRA_APERTA:
+                if (open.size() >= limit)
+                    throw too_deep();
+                open.push(grammar_state::list_first);
+                h.on_start_array();
+                break;
+            case TOKEN::STRING:
+                get_json_string(v, h);
+                break;
+            case TOKEN::NUMBER:
+                get_json_number(v, h);
+                break;
+            case TOKEN::BOOLEAN:
+                get_json_boolean(v, h);
+                break;
+            default:
+                get_json_null(v, h);
+                break;
+        }
+    };
+
+    grammar_state document = grammar_state::document;
+    advance(document, symbol_of(token, strict), strict);
+    begin_value(token);
+    Token next;
+    while (!open.empty()) {
+        next = t.get_token();
+        grammar_symbol symbol = symbol_of(next, strict);
+        switch (advance(open.back(), symbol, strict)) {
+            case grammar_action::key:
+                key = std::move(next);
+                break;
+            case grammar_action::member:
+                h.on_key(key.type == TOKEN::STRING ? key.text() : std::string_view(key.value));
+                if constexpr (skips_members<Handler>::value) {
+                    if (h.skip_member()) {
+                        skip_value(next, t);
+                        break;
+                    }
+                }
+                begin_value(next);
+                break;
+            case grammar_action::element:
+                begin_value(next);
+                break;
+            case grammar_action::close:
+                open.pop();
+                if (symbol == grammar_symbol::close_dictionary)
+                    h.on_end_object();
+                else
+                    h.on_end_array();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* reports every value of the stream to h, one after the other */
+template<class Handler>
+static void parse_stream(std::istream &input, Handler &h) {
+    if (input.rdbuf() == nullptr)
+        throw json_exception{"stream without a buffer", json_errc::io_error};
+    stat_timer timer(stat_id::parse_ns);
+    Tokenizer t = Tokenizer(*input.rdbuf());
+
+
+    try {
+        while (true) {
+            Token token = t.get_token();
+            if(token.type == TOKEN::FINE_INPUT){
+                break;
+            }
+            get_json_value(token, t, h);
+            count_stat(stat_id::documents);
+        }
+    } catch (json_exception &e) {
+        t.locate(e);
+        throw;
+    }
+    input.setstate(std::ios_base::eofbit);
+}
+
+std::istream &operator>>(std::istream &lhs, json &rhs) {
+    tree_builder b(nullptr, std::string_view());
+    parse_stream(lhs, b);
+    if (b.done())
+        rhs = std::move(b.root());
+    return lhs;
+}
+
+void json::parse(std::istream &input, handler &h) {
+    parse_stream(input, h);
+}
+
+/* reports exactly the one value t holds to h */
+template<class Handler>
+static void parse_document(Tokenizer &t, Handler &h) {
+    try {
+        Token token = t.get_token();
+        get_json_value(token, t, h);
+        if (t.get_token().type != TOKEN::FINE_INPUT)
+            throw json_exception{"unexpected characters after the json value", json_errc::trailing_characters};
+    } catch (json_exception &e) {
+        t.locate(e);
+        throw;
+    }
+}
+
+/* Reports exactly one value out of input to h. The plain tokenizer
+   reads strings, numbers and literals byte by byte anyway, so a pass
+   building the structural index first only adds to it: bench --compare
+   has the indexed tokenizer slower on every file. The index is left to
+   the parallel parser, which needs it to split a list. */
+template<class Handler>
+static void parse_events(std::string_view input, Handler &h) {
+    stat_timer timer(stat_id::parse_ns);
+    count_stat(stat_id::documents);
+    count_stat(stat_id::bytes, input.size());
+    Tokenizer t(input);
+    parse_document(t, h);
+}
+
+void json::parse(std::string_view input, handler &h) {
+    parse_events(input, h);
+}
+
+/* The plain tokenizer, as for parse(), only checking strings: it takes
+   no memory. */
+json::validation json::validate(std::string_view input) {
+    stat_timer timer(stat_id::parse_ns);
+    count_stat(stat_id::documents);
+    count_stat(stat_id::bytes, input.size());
+    Tokenizer t(input);
+    t.check_only = true;
+    validator<true> v;
+    parse_document(t, v);
+    return v.result;
+}
+
+bool json::try_validate(std::string_view input, validation *out, json_exception *error) {
+    try {
+        validation v = validate(input);
+        if (out != nullptr)
+            *out = v;
+        return true;
+    } catch (json_exception &e) {
+        if (error != nullptr)
+            *error = std::move(e);
+        return false;
+    }
+}
+
+/* tree_builder behind the virtual interface, for the push parser */
+class tree_handler : public json::handler {
+public:
+    tree_handler() : b(nullptr, std::string_view()) {}
+
+    void on_null() override { this->b.on_null(); }
+    void on_boolean(bool value) override { this->b.on_boolean(value); }
+    void on_number(double value) override { this->b.on_number(value); }
+    void on_integer(std::int64_t value) override { this->b.on_integer(value); }
+    void on_string(std::string_view text) override { this->b.on_string(text); }
+    void on_key(std::string_view key) override { this->b.on_key(key); }
+    void on_start_object() override { this->b.on_start_object(); }
+    void on_end_object() override { this->b.on_end_object(); }
+    void on_start_array() override { this->b.on_start_array(); }
+    void on_end_array() override { this->b.on_end_array(); }
+
+    tree_builder b;
+};
+
+static bool is_letter(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+struct json::push_parser::state {
+    /* the token cut by the end of the last chunk */
+    enum class partial : unsigned char {
+        none,
+        string,
+        number,
+        literal,
+    };
+
+    explicit state(json::handler *h) : h(h) {
+        if (h == nullptr) {
+            this->tree.reset(new tree_handler());
+            this->h = this->tree.get();
+        }
+    }
+
+    /* feeds [begin, end), giving the errors their position */
+    status feed(const char *begin, const char *end);
+    status scan(const char *&p, const char *end);
+    void finish();
+    void complete();
+    /* the position of offset for e, counting the lines of [begin, p) */
+    void locate(json_exception &e, const char *begin, const char *p) const;
+    /* counts the lines of a chunk consumed whole */
+    void consume(const char *begin, const char *end);
+
+    /* scans the token cut last time, returns where it ends in [p, end) */
+    const char *resume(const char *p, const char *end);
+
+    /* steps the grammar over a token of the given symbol, name being
+       its text if it can be a key; true for a value to report */
+    bool step(grammar_symbol symbol, std::string_view name = std::string_view());
+    void end_value();
+    /* is the value complete? */
+    bool done() const {
+        return this->open.empty() && this->document == grammar_state::done;
+    }
+    /* raw is what is between the quotes, escape sequences included */
+    void string_done(std::string_view raw);
+    void number_done(std::string_view text);
+    void literal_done(std::string_view text);
+
+    json::handler *h;
+    std::unique_ptr<tree_handler> tree;
+    /* the grammar state of every open container, and of the document */
+    vector<grammar_state> open;
+    grammar_state document = grammar_state::document;
+    /* the key of the member being read */
+    std::string key;
+    partial cut = partial::none;
+    bool escaped = false;
+    /* the characters of the cut token read so far */
+    std::string pending;
+    /* the text of the last string with escape sequences */
+    std::string decoded;
+    /* bytes and lines of the previous chunks, and where the line going
+       on at the end of them started */
+    std::size_t fed = 0;
+    std::size_t lines = 0;
+    std::size_t line_begin = 0;
+    /* the chunk being fed, and where the cut token started */
+    const char *chunk = nullptr;
+    std::size_t cut_offset = 0;
+    /* is the cut token being completed? its errors are at cut_offset */
+    bool resuming = false;
+};
+
+json::push_parser::status json::push_parser::state::feed(const char *begin, const char *end) {
+    const char *p = begin;
+    this->chunk = begin;
+    try {
+        status s = this->scan(p, end);
+        this->consume(begin, end);
+        return s;
+    } catch (json_exception &e) {
+        this->locate(e, begin, p);
+        throw;
+    }
+}
+
+void json::push_parser::state::consume(const char *begin, const char *end) {
+    for (const char *p = begin; p != end && (p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr; ++p) {
+        ++this->lines;
+        this->line_begin = this->fed + (p - begin) + 1;
+    }
+    this->fed += end - begin;
+}
+
+void json::push_parser::state::locate(json_exception &e, const char *begin, const char *p) const {
+    if (e.line != 0)
+        return;
+    std::size_t line = this->lines;
+    std::size_t line_start = this->line_begin;
+    for (const char *q = begin; q != p && (q = static_cast<const char *>(std::memchr(q, '\n', p - q))) != nullptr; ++q) {
+        ++line;
+        line_start = this->fed + (q - begin) + 1;
+    }
+    e.offset = this->resuming ? this->cut_offset : this->fed + (p - begin);
+    e.line = line + 1;
+    e.column = e.offset - std::min(line_start, e.offset) + 1;
+}
+
+json::push_parser::status json::push_parser::state::scan(const char *&p, const char *end) {
+    if (this->cut != partial::none) {
+        this->resuming = true;
+        p = this->resume(p, end);
+        this->resuming = false;
+    }
+    while (p != end) {
+        char c = *p;
+        switch (class_of(c)) {
+            case char_class::space:
+                ++p;
+                break;
+            case char_class::quote: {
+                const char *quote = find_closing_quote(p + 1, end, this->escaped);
+                if (quote == nullptr) {
+                    this->pending.assign(p + 1, end);
+                    this->cut = partial::string;
+                    this->cut_offset = this->fed + (p - this->chunk);
+                    return status::need_more_data;
+                }
+                this->string_done(std::string_view(p + 1, quote - p - 1));
+                p = quote + 1;
+                break;
+            }
+            case char_class::number:
+            case char_class::false_literal:
+            case char_class::true_literal:
+            case char_class::null_literal:
+            case char_class::letter: {
+                bool number = class_of(c) == char_class::number;
+                const char *q = p + 1;
+                while (q != end && (number ? is_number_char(*q) : is_letter(*q))) ++q;
+                if (q == end) {
+                    this->pending.assign(p, end);
+                    this->cut = number ? partial::number : partial::literal;
+                    this->cut_offset = this->fed + (p - this->chunk);
+                    return status::need_more_data;
+                }
+                if (number)
+                    this->number_done(std::string_view(p, q - p));
+                else
+                    this->literal_done(std::string_view(p, q - p));
+                p = q;
+                break;
+            }
+            case char_class::open_brace:
+            case char_class::open_bracket:
+                count_token(static_cast<TOKEN>(c));
+                if (this->step(grammar_symbol::open)) {
+                    if (this->open.size() >= json::max_depth())
+                        throw too_deep();
+                    if (c == '{') {
+                        this->open.push_back(grammar_state::object_key);
+                        this->h->on_start_object();
+                    } else {
+                        this->open.push_back(grammar_state::list_first);
+                        this->h->on_start_array();
+                    }
+                }
+                ++p;
+                break;
+            case char_class::close_brace:
+            case char_class::close_bracket:
+                count_token(static_cast<TOKEN>(c));
+                this->step(c == '}' ? grammar_symbol::close_dictionary : grammar_symbol::close_list);
+                ++p;
+                break;
+            case char_class::comma:
+                count_token(TOKEN::VIRGOLA);
+                this->step(grammar_symbol::comma);
+                ++p;
+                break;
+            case char_class::colon:
+                count_token(TOKEN::DUE_PUNTI);
+                this->step(grammar_symbol::colon);
+                ++p;
+                break;
+            default:
+                throw json_exception{std::string("carattere non identificato: ") + c, json_errc::unexpected_character};
+        }
+    }
+    return this->done() ? status::complete : status::need_more_data;
+}
+
+const char *json::push_parser::state::resume(const char *p, const char *end) {
+    if (this->cut == partial::string) {
+        const char *quote = find_closing_quote(p, end, this->escaped);
+        if (quote == nullptr) {
+            this->pending.append(p, end);
+            return end;
+        }
+        this->pending.append(p, quote);
+        this->cut = partial::none;
+        this->string_done(this->pending);
+        return quote + 1;
+    }
+    bool number = this->cut == partial::number;
+    const char *q = p;
+    while (q != end && (number ? is_number_char(*q) : is_letter(*q))) ++q;
+    this->pending.append(p, q);
+    if (q == end)
+        return end;
+    this->cut = partial::none;
+    if (number)
+        this->number_done(this->pending);
+    else
+        this->literal_done(this->pending);
+    return q;
+}
+
+void json::push_parser::state::finish() {
+    this->resuming = this->cut != partial::none;
+    try {
+        this->complete();
+    } catch (json_exception &e) {
+        this->locate(e, nullptr, nullptr);
+        throw;
+    }
+}
+
+void json::push_parser::state::complete() {
+    if (this->cut == partial::string)
+        throw json_exception{"stringa non terminata", json_errc::unterminated_string};
+    if (this->cut != partial::none) {
+        bool number = this->cut == partial::number;
+        this->cut = partial::none;
+        if (number)
+            this->number_done(this->pending);
+        else
+            this->literal_done(this->pending);
+        this->resuming = false;
+    }
+    if (!this->done())
+        throw json_exception{"unexpected end of input", json_errc::unexpected_end};
+}
+
+bool json::push_parser::state::step(grammar_symbol symbol, std::string_view name) {
+    grammar_state &s = this->open.empty() ? this->document : *this->open.back();
+    switch (advance(s, symbol)) {
+        case grammar_action::key:
+            this->key.assign(name.data(), name.size());
+            return false;
+        case grammar_action::member:
+            this->h->on_key(this->key);
+            return true;
+        case grammar_action::element:
+            return true;
+        case grammar_action::close:
+            this->open.pop_back();
+            if (symbol == grammar_symbol::close_dictionary)
+                this->h->on_end_object();
+            else
+                this->h->on_end_array();
+            this->end_value();
+            return false;
+        default:
+            return false;
+    }
+}
+
+void json::push_parser::state::end_value() {
+    if (this->open.empty())
+        count_stat(stat_id::documents);
+}
+
+void json::push_parser::state::string_done(std::string_view raw) {
+    count_token(TOKEN::STRING);
+    std::string_view text = unescape(raw, this->decoded);
+    if (!this->step(grammar_symbol::name, text))
+        return;
+    this->h->on_string(text);
+    this->end_value();
+}
+
+void json::push_parser::state::number_done(std::string_view text) {
+    count_token(TOKEN::NUMBER);
+    Token token;
+    if (!parse_number(text.data(), text.data() + text.size(), token))
+        throw json_exception{"numero non valido", json_errc::invalid_number};
+    if (!this->step(grammar_symbol::scalar))
+        return;
+    if (token.integral)
+        this->h->on_integer(token.integer);
+    else
+        this->h->on_number(token.number);
+    this->end_value();
+}
+
+/* A run of letters, like the Tokenizer reads it: a literal ends after
+   its last letter and the letters after it start the next token. */
+void json::push_parser::state::literal_done(std::string_view text) {
+    while (!text.empty()) {
+        std::string_view word;
+        if (text[0] == 't')
+            word = "true";
+        else if (text[0] == 'f')
+            word = "false";
+        else if (text[0] == 'n')
+            word = "null";
+        else
+            throw json_exception{std::string("carattere non identificato: ") + text[0], json_errc::unexpected_character};
+        if (text.substr(0, word.size()) != word)
+            throw json_exception{"literal not valid: " + std::string(text), json_errc::invalid_literal};
+        text.remove_prefix(word.size());
+        bool null = word == "null";
+        count_token(null ? TOKEN::NULLO : TOKEN::BOOLEAN);
+        /* as a key, a boolean reads like the Tokenizer's value of the token */
+        if (!this->step(null ? grammar_symbol::scalar : grammar_symbol::name, word == "true" ? "True" : "False"))
+            continue;
+        if (null)
+            this->h->on_null();
+        else
+            this->h->on_boolean(word == "true");
+        this->end_value();
+    }
+}
+
+json::push_parser::push_parser() : st(new state(nullptr)) {}
+
+json::push_parser::push_parser(handler &h) : st(new state(&h)) {}
+
+json::push_parser::~push_parser() {
+    delete this->st;
+}
+
+json::push_parser::status json::push_parser::feed(const char *data, std::size_t n) {
+    count_stat(stat_id::bytes, n);
+    return this->st->feed(data, data + n);
+}
+
+void json::push_parser::finish() {
+    this->st->finish();
+}
+
+void json::push_parser::reset() {
+    state *fresh = new state(this->st->tree ? nullptr : this->st->h);
+    delete this->st;
+    this->st = fresh;
+}
+
+json &json::push_parser::root() {
+    if (!this->st->tree)
+        throw json_exception{"the events go to a handler, there is no tree"};
+    if (!this->st->tree->b.done() || !this->st->done())
+        throw json_exception{"the value is not complete"};
+    return this->st->tree->b.root();
+}
+
+/* parses exactly one value out of input, placing containers in a;
+   pinned tells that input lives as long as the tree */
+static json parse_value(std::string_view input, json::arena *a, bool pinned) {
+    tree_builder b(a, pinned ? input : std::string_view());
+    parse_events(input, b);
+    return std::move(b.root());
+}
+
+json json::parse(std::string_view input) {
+    return parse_value(input, nullptr, false);
+}
+
+bool json::try_parse(std::string_view input, json &out, json_exception *error) {
+    try {
+        out = parse_value(input, nullptr, false);
+        return true;
+    } catch (json_exception &e) {
+        if (error != nullptr)
+            *error = std::move(e);
+        return false;
+    }
+}
+
+/* Read-only view of a whole file. Where mmap is available the pages of
+   a regular file are mapped straight from the page cache; a pipe, a
+   device or a file that says it is empty, as those of /proc do, is read
+   into memory once, as is every file elsewhere. */
+class mapped_file {
+public:
+    explicit mapped_file(std::string const &path) {
+#ifdef JSON_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw json_exception{"cannot open " + path + ": " + std::strerror(errno), json_errc::io_error};
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw json_exception{"cannot stat " + path + ": " + std::strerror(err), json_errc::io_error};
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+            char buffer[65536];
+            ssize_t n;
+            while ((n = ::read(fd, buffer, sizeof buffer)) != 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0) {
+                    int err = errno;
+                    ::close(fd);
+                    throw json_exception{"cannot read " + path + ": " + std::strerror(err), json_errc::io_error};
+                }
+                contents.append(buffer, static_cast<std::size_t>(n));
+            }
+            ::close(fd);
+            addr = contents.data();
+            length = contents.size();
+            return;
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        void *p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw json_exception{"cannot map " + path + ": " + std::strerror(err), json_errc::io_error};
+        }
+        ::madvise(p, length, MADV_SEQUENTIAL);
+        addr = static_cast<const char *>(p);
+        mapped = true;
+        ::close(fd);  // the mapping keeps the file alive
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw json_exception{"cannot open " + path, json_errc::io_error};
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        addr = contents.data();
+        length = contents.size();
+#endif
+    }
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+
+    ~mapped_file() {
+#ifdef JSON_HAS_MMAP
+        if (mapped)
+            ::munmap(const_cast<char *>(addr), length);
+#endif
+    }
+
+    std::string_view view() const {
+        return {addr, length};
+    }
+
+private:
+    const char *addr = nullptr;
+    std::size_t length = 0;
+#ifdef JSON_HAS_MMAP
+    bool mapped = false;
+#endif
+    /* what was read, when not mapped */
+    std::string contents;
+};
+
+json json::parse_file(std::string const &path) {
+    mapped_file file(path);
+    return json::parse(file.view());
+}
+
+/*
+    CBOR
+
+    Every data item starts with a byte holding its major type in the
+    top 3 bits and in the low 5 bits either a small argument (< 24) or
+    the size of the argument that follows in big endian (24..27 for
+    1, 2, 4 or 8 bytes). 31 marks the indefinite length strings and
+    containers that end with a 0xff break.
+*/
+
+enum cbor_major : unsigned char {
+    cbor_unsigned = 0,
+    cbor_negative = 1,
+    cbor_bytes = 2,
+    cbor_text = 3,
+    cbor_array = 4,
+    cbor_map = 5,
+    cbor_tag = 6,
+    cbor_simple = 7,
+};
+
+class cbor_encoder {
+public:
+    explicit cbor_encoder(writer &out) : out(out) {}
+
+    void value(json const &j) {
+        if (j.is_integer()) {
+            std::int64_t x = j.get_integer();
+            if (x >= 0)
+                this->head(cbor_unsigned, static_cast<uint64_t>(x));
+            else
+                this->head(cbor_negative, static_cast<uint64_t>(-1 - x));
+        } else if (j.is_number()) {
+            this->number(j.get_number());
+        } else if (j.is_string()) {
+            std::string_view text = j.get_string_view();
+            this->head(cbor_text, text.size());
+            this->out.write(text);
+        } else if (j.is_list()) {
+            this->head(cbor_array, j.size());
+            for (json::const_list_iterator it = j.begin_list(); it != j.end_list(); ++it)
+                this->value(*it);
+        } else if (j.is_dictionary()) {
+            this->head(cbor_map, j.size());
+            for (json::const_dictionary_iterator it = j.begin_dictionary(); it != j.end_dictionary(); ++it) {
+                this->head(cbor_text, it->first.size());
+                this->out.write(it->first);
+                this->value(it->second);
+            }
+        } else if (j.is_bool()) {
+            this->out.put(j.get_bool() ? '\xf5' : '\xf4');
+        } else {
+            this->out.put('\xf6');
+        }
+    }
+
+private:
+    /* the initial byte and the argument in the fewest bytes */
+    void head(cbor_major major, uint64_t argument) {
+        char buffer[9];
+        std::size_t bytes;
+        unsigned char info;
+        if (argument < 24) {
+            info = static_cast<unsigned char>(argument);
+            bytes = 0;
+        } else if (argument <= 0xff) {
+            info = 24;
+            bytes = 1;
+        } else if (argument <= 0xffff) {
+            info = 25;
+            bytes = 2;
+        } else if (argument <= 0xffffffff) {
+            info = 26;
+            bytes = 4;
+        } else {
+            info = 27;
+            bytes = 8;
+        }
+        buffer[0] = static_cast<char>((major << 5) | info);
+        for (std::size_t i = 0; i < bytes; ++i)
+            buffer[bytes - i] = static_cast<char>(argument >> (8 * i));
+        this->out.write(buffer, bytes + 1);
+    }
+
+    void number(double x) {
+        float f = static_cast<float>(x);
+        if (static_cast<double>(f) == x || x != x) {
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            this->major7(26, bits, 4);
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            this->major7(27, bits, 8);
+        }
+    }
+
+    void major7(unsigned char info, uint64_t bits, std::size_t bytes) {
+        char buffer[9];
+        buffer[0] = static_cast<char>((cbor_simple << 5) | info);
+        for (std::size_t i = 0; i < bytes; ++i)
+            buffer[bytes - i] = static_cast<char>(bits >> (8 * i));
+        this->out.write(buffer, bytes + 1);
+    }
+
+    writer &out;
+};
+
+/* Reads data items out of [p, end), reporting them to a handler. */
+template<class Handler>
+class cbor_decoder {
+public:
+    cbor_decoder(const char *p, const char *end, Handler &h) : p(p), end(end), h(h), limit(json::max_depth()) {}
+
+    /* reads one data item, past the end of the input when it is over;
+       containers and tags nest at most json::max_depth() deep */
+    void item() {
+        if (this->depth >= this->limit)
+            throw too_deep();
+        ++this->depth;
+        this->read_item();
+        --this->depth;
+    }
+
+    bool done() const {
+        return this->p == this->end;
+    }
+
+private:
+    void read_item() {
+        unsigned char initial = this->byte();
+        unsigned char major = initial >> 5;
+        unsigned char info = initial & 31;
+        if (major == cbor_simple) {
+            this->simple(info);
+            return;
+        }
+        if (info == 31) {
+            this->indefinite(major);
+            return;
+        }
+        uint64_t argument = this->argument(info);
+        switch (major) {
+            case cbor_unsigned:
+                if (argument <= uint64_t(INT64_MAX))
+                    this->h.on_integer(static_cast<std::int64_t>(argument));
+                else
+                    this->h.on_number(static_cast<double>(argument));
+                break;
+            case cbor_negative:
+                if (argument <= uint64_t(INT64_MAX))
+                    this->h.on_integer(-1 - static_cast<std::int64_t>(argument));
+                else
+                    this->h.on_number(-1.0 - static_cast<double>(argument));
+                break;
+            case cbor_bytes:
+                throw no_bytes();
+            case cbor_text:
+                this->h.on_string(this->text(argument));
+                break;
+            case cbor_array:
+                this->h.on_start_array();
+                for (uint64_t i = 0; i < argument; ++i)
+                    this->item();
+                this->h.on_end_array();
+                break;
+            case cbor_map:
+                this->h.on_start_object();
+                for (uint64_t i = 0; i < argument; ++i) {
+                    this->key();
+                    this->item();
+                }
+                this->h.on_end_object();
+                break;
+            case cbor_tag:
+                this->item();
+                break;
+        }
+    }
+
+    unsigned char byte() {
+        if (this->p == this->end)
+            throw json_exception{"cbor: unexpected end of input", json_errc::invalid_cbor};
+        return static_cast<unsigned char>(*this->p++);
+    }
+
+    uint64_t big_endian(std::size_t bytes) {
+        if (static_cast<std::size_t>(this->end - this->p) < bytes)
+            throw json_exception{"cbor: unexpected end of input", json_errc::invalid_cbor};
+        uint64_t x = 0;
+        for (std::size_t i = 0; i < bytes; ++i)
+            x = (x << 8) | static_cast<unsigned char>(this->p[i]);
+        this->p += bytes;
+        return x;
+    }
+
+    uint64_t argument(unsigned char info) {
+        if (info < 24)
+            return info;
+        if (info > 27)
+            throw json_exception{"cbor: reserved additional information", json_errc::invalid_cbor};
+        return this->big_endian(std::size_t(1) << (info - 24));
+    }
+
+    std::string_view chunk(uint64_t size) {
+        if (static_cast<uint64_t>(this->end - this->p) < size)
+            throw json_exception{"cbor: unexpected end of input", json_errc::invalid_cbor};
+        std::string_view s(this->p, size);
+        this->p += size;
+        return s;
+    }
+
+    /* the next size bytes, a text string that has to be UTF-8 */
+    std::string_view text(uint64_t size) {
+        std::string_view s = this->chunk(size);
+        if (!valid_utf8(s.data(), s.data() + s.size()))
+            throw json_exception{"cbor: invalid UTF-8 in a text string", json_errc::invalid_cbor};
+        return s;
+    }
+
+    /* json has no type for raw bytes, and a string of them may not even
+       be UTF-8 */
+    static json_exception no_bytes() {
+        return json_exception{"cbor: byte string, which json has no type for", json_errc::wrong_type};
+    }
+
+    /* the chunks of an indefinite length text string, up to the break */
+    std::string joined_text() {
+        std::string joined;
+        while (!this->at_break()) {
+            unsigned char initial = this->byte();
+            if ((initial >> 5) != cbor_text || (initial & 31) == 31)
+                throw json_exception{"cbor: bad chunk of an indefinite length string", json_errc::invalid_cbor};
+            std::string_view s = this->text(this->argument(initial & 31));
+            joined.append(s.data(), s.size());
+        }
+        return joined;
+    }
+
+    /* is the next byte the break that ends an indefinite length item? */
+    bool at_break() {
+        if (this->p == this->end)
+            throw json_exception{"cbor: unexpected end of input", json_errc::invalid_cbor};
+        if (static_cast<unsigned char>(*this->p) != 0xff)
+            return false;
+        ++this->p;
+        return true;
+    }
+
+    void indefinite(unsigned char major) {
+        if (major == cbor_bytes) {
+            throw no_bytes();
+        } else if (major == cbor_text) {
+            this->h.on_string(this->joined_text());
+        } else if (major == cbor_array) {
+            this->h.on_start_array();
+            while (!this->at_break())
+                this->item();
+            this->h.on_end_array();
+        } else if (major == cbor_map) {
+            this->h.on_start_object();
+            while (!this->at_break()) {
+                this->key();
+                this->item();
+            }
+            this->h.on_end_object();
+        } else {
+            throw json_exception{"cbor: indefinite length integer or tag", json_errc::invalid_cbor};
+        }
+    }
+
+    /* map keys have to be strings in json */
+    void key() {
+        unsigned char initial = this->byte();
+        unsigned char major = initial >> 5;
+        if (major == cbor_bytes)
+            throw no_bytes();
+        if (major != cbor_text)
+            throw json_exception{"cbor: map key is not a string", json_errc::invalid_cbor};
+        if ((initial & 31) == 31)
+            this->h.on_key(this->joined_text());
+        else
+            this->h.on_key(this->text(this->argument(initial & 31)));
+    }
+
+    void simple(unsigned char info) {
+        switch (info) {
+            case 20:
+                this->h.on_boolean(false);
+                break;
+            case 21:
+                this->h.on_boolean(true);
+                break;
+            case 22:
+            case 23:  // undefined
+                this->h.on_null();
+                break;
+            case 24:
+                /* other simple values carry no meaning in json */
+                this->byte();
+                this->h.on_null();
+                break;
+            case 25:
+                this->h.on_number(half_to_double(static_cast<uint16_t>(this->big_endian(2))));
+                break;
+            case 26: {
+                uint32_t bits = static_cast<uint32_t>(this->big_endian(4));
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                this->h.on_number(f);
+                break;
+            }
+            case 27: {
+                uint64_t bits = this->big_endian(8);
+                double x;
+                std::memcpy(&x, &bits, sizeof(x));
+                this->h.on_number(x);
+                break;
+            }
+            case 31:
+                throw json_exception{"cbor: break outside an indefinite length item", json_errc::invalid_cbor};
+            default:
+                if (info < 20) {
+                    this->h.on_null();
+                    break;
+                }
+                throw json_exception{"cbor: reserved simple value", json_errc::invalid_cbor};
+        }
+    }
+
+    static double half_to_double(uint16_t half) {
+        int exponent = (half >> 10) & 0x1f;
+        double mantissa = half & 0x3ff;
+        double x;
+        if (exponent == 0)
+            x = std::ldexp(mantissa, -24);
+        else if (exponent != 31)
+            x = std::ldexp(mantissa + 1024, exponent - 25);
+        else
+            x = mantissa == 0 ? HUGE_VAL : NAN;
+        return (half & 0x8000) ? -x : x;
+    }
+
+    const char *p;
+    const char *end;
+    Handler &h;
+    std::size_t limit;
+    std::size_t depth = 0;
+};
+
+template<class Handler>
+static void parse_cbor_item(std::string_view data, Handler &h) {
+    cbor_decoder<Handler> decoder(data.data(), data.data() + data.size(), h);
+    decoder.item();
+    if (!decoder.done())
+        throw json_exception{"cbor: unexpected bytes after the data item", json_errc::invalid_cbor};
+}
+
+std::string json::to_cbor() const {
+    std::string out;
+    {
+        writer w(out);
+        cbor_encoder(w).value(*this);
+    }
+    return out;
+}
+
+json json::from_cbor(std::string_view data) {
+    tree_builder b(nullptr, std::string_view());
+    parse_cbor_item(data, b);
+    return std::move(b.root());
+}
+
+void json::parse_cbor(std::string_view data, handler &h) {
+    parse_cbor_item(data, h);
+}
+
+json::document::document() : a(new arena) {}
+
+json::document::document(document &&d) noexcept : a(d.a), value(std::move(d.value)) {
+    d.a = nullptr;
+}
+
+json::document::~document() {
+    /* the tree has to go before the arena it lives in */
+    this->value.set_null();
+    delete this->a;
+}
+
+json::document &json::document::operator=(document &&d) noexcept {
+    if (this != &d) {
+        this->value.set_null();
+        delete this->a;
+        this->a = d.a;
+        this->value = std::move(d.value);
+        d.a = nullptr;
+    }
+    return *this;
+}
+
+void json::document::clear() {
+    this->value.set_null();
+    if (this->a == nullptr)
+        this->a = new arena;
+    else
+        this->a->reset();
+}
+
+void json::document::parse(std::string_view input) {
+    this->clear();
+    char *copy = static_cast<char *>(this->a->allocate(input.size(), 1));
+    if (!input.empty())
+        std::memcpy(copy, input.data(), input.size());
+    this->value = parse_value(std::string_view(copy, input.size()), this->a, true);
+}
+
+void json::document::parse_borrowed(std::string_view input) {
+    this->clear();
+    this->value = parse_value(input, this->a, true);
+}
+
+void json::document::parse_file(std::string const &path) {
+    this->clear();
+    mapped_file *file = this->a->make<mapped_file>(path);
+    this->value = parse_value(file->view(), this->a, true);
+}
+
+json &json::document::root() {
+    return this->value;
+}
+
+json const &json::document::root() const {
+    return this->value;
+}
+
+std::size_t json::document::arena_size() const {
+    return this->a != nullptr ? this->a->size() : 0;
+}
+
+/* The keys are decoded the first time one is looked up, into names:
+   a key without escape sequences is used as it is in the input, the
+   others are decoded once into decoded. Past index_threshold keys, as
+   for a dictionary, they are found through an open addressing table
+   whose slots pack the upper 32 bits of the hash with position + 1. */
+struct json::lazy::children {
+    vector<lazy> values;
+    /* for a dictionary, with escape sequences left as they are */
+    vector<std::string_view> keys;
+    vector<std::string_view> names;
+    std::string decoded;
+    vector<uint64_t> index;
+
+    /* the first value of key, nullptr if missing */
+    lazy const *find(std::string_view key) {
+        if (this->names.size() != this->keys.size())
+            this->name_keys();
+        if (this->index.empty()) {
+            for (std::size_t i = 0; i < this->names.size(); ++i)
+                if (this->names[i] == key)
+                    return &this->values[i];
+            return nullptr;
+        }
+        uint64_t h = dictionary_storage::hash(key);
+        uint64_t mask = this->index.size() - 1;
+        for (uint64_t i = h & mask;; i = (i + 1) & mask) {
+            uint64_t slot = this->index[i];
+            if (slot == 0)
+                return nullptr;
+            /* a repeated key sits after the first one on its probe chain */
+            if ((slot >> 32) == (h >> 32) && this->names[(slot & 0xffffffff) - 1] == key)
+                return &this->values[(slot & 0xffffffff) - 1];
+        }
+    }
+
+private:
+    void name_keys() {
+        std::size_t escaped = 0;
+        for (std::string_view k : this->keys)
+            if (k.find('\\') != std::string_view::npos)
+                escaped += k.size();
+        /* sized once: the views into it stay valid */
+        this->decoded.resize(escaped);
+        char *out = &this->decoded[0];
+        this->names.reserve(this->keys.size());
+        for (std::string_view k : this->keys) {
+            if (k.find('\\') == std::string_view::npos) {
+                this->names.push_back(k);
+            } else {
+                std::size_t n = unescape(k.data(), k.data() + k.size(), out);
+                this->names.push_back(std::string_view(out, n));
+                out += n;
+            }
+        }
+        if (this->names.size() <= dictionary_storage::index_threshold)
+            return;
+        uint64_t n = 16;
+        while (n < 4 * this->names.size()) n *= 2;
+        this->index.reserve(n);
+        for (uint64_t i = 0; i != n; ++i) this->index.push_back(0);
+        for (uint64_t pos = 0; pos != this->names.size(); ++pos) {
+            uint64_t h = dictionary_storage::hash(this->names[pos]);
+            uint64_t i = h & (n - 1);
+            while (this->index[i] != 0) i = (i + 1) & (n - 1);
+            this->index[i] = (h >> 32 << 32) | (pos + 1);
+        }
+    }
+};
+
+json::lazy::lazy(std::string_view input) : cache(nullptr) {
+    const char *end = input.data() + input.size();
+    const char *begin = skip_space(input.data(), end);
+    const char *last = skip_value(begin, end);
+    if (skip_space(last, end) != end)
+        throw json_exception{"unexpected characters after the json value", json_errc::trailing_characters};
+    this->range = std::string_view(begin, last - begin);
+}
+
+json::lazy::lazy(const char *begin, const char *end) : range(begin, end - begin), cache(nullptr) {}
+
+json::lazy::lazy(lazy &&v) noexcept : range(v.range), cache(v.cache) {
+    v.cache = nullptr;
+}
+
+json::lazy::~lazy() {
+    delete this->cache;
+}
+
+json::lazy &json::lazy::operator=(lazy &&v) noexcept {
+    if (this != &v) {
+        delete this->cache;
+        this->range = v.range;
+        this->cache = v.cache;
+        v.cache = nullptr;
+    }
+    return *this;
+}
+
+bool json::lazy::is_list() const {
+    return this->range.front() == '[';
+}
+
+bool json::lazy::is_dictionary() const {
+    return this->range.front() == '{';
+}
+
+bool json::lazy::is_string() const {
+    return this->range.front() == '"';
+}
+
+bool json::lazy::is_number() const {
+    return this->range.front() == '-' || is_digit(this->range.front());
+}
+
+bool json::lazy::is_integer() const {
+    if (!this->is_number())
+        return false;
+    Token token;
+    return parse_number(this->range.data(), this->range.data() + this->range.size(), token) && token.integral;
+}
+
+bool json::lazy::is_bool() const {
+    return this->range == "true" || this->range == "false";
+}
+
+bool json::lazy::is_null() const {
+    return this->range == "null";
+}
+
+/* the grammar symbol of the token starting with c */
+static grammar_symbol symbol_at(char c) {
+    switch (c) {
+        case '"':
+            return grammar_symbol::name;
+        case '{':
+        case '[':
+            return grammar_symbol::open;
+        case ':':
+            return grammar_symbol::colon;
+        case ',':
+            return grammar_symbol::comma;
+        case ']':
+            return grammar_symbol::close_list;
+        case '}':
+            return grammar_symbol::close_dictionary;
+        default:
+            return grammar_symbol::scalar;
+    }
+}
+
+/* One level of the container: every child is located by skipping it,
+   the tokens in between going through the grammar as validate() reads
+   it, which also gives the errors. */
+json::lazy::children const &json::lazy::split() const {
+    if (this->cache != nullptr)
+        return *this->cache;
+    bool dictionary = this->is_dictionary();
+    if (!dictionary && !this->is_list())
+        throw json_exception{"this is not a list or a dictionary", json_errc::wrong_type};
+    std::unique_ptr<children> c(new children());
+    const char *end = this->range.data() + this->range.size() - 1;  // the closing bracket
+    grammar_state s = dictionary ? grammar_state::object_key : grammar_state::list_first;
+    const char *p = skip_space(this->range.data() + 1, end);
+    while (true) {
+        grammar_symbol symbol = symbol_at(*p);
+        grammar_action action = advance(s, symbol, true);
+        if (action == grammar_action::close) {
+            if (p != end)
+                throw grammar_error(grammar_action::invalid, symbol);
+            break;
+        }
+        if (action == grammar_action::key) {
+            const char *key_end = skip_string(p, end);
+            c->keys.push_back(std::string_view(p + 1, key_end - p - 2));
+            p = key_end;
+        } else if (action == grammar_action::shift) {
+            ++p;
+        } else {
+            const char *value_end = skip_value(p, end);
+            c->values.push_back(lazy(p, value_end));
+            p = value_end;
+        }
+        p = skip_space(p, end);
+    }
+    this->cache = c.release();
+    return *this->cache;
+}
+
+json::lazy const &json::lazy::operator[](std::string_view key) const {
+    if (!this->is_dictionary())
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    this->split();
+    if (lazy const *value = this->cache->find(key))
+        return *value;
+    throw json_exception{"key not found: " + std::string(key), json_errc::not_found};
+}
+
+json::lazy const &json::lazy::operator[](std::size_t i) const {
+    children const &c = this->split();
+    if (i >= c.values.size())
+        throw json_exception{"index out of range", json_errc::out_of_range};
+    return c.values[i];
+}
+
+std::string_view json::lazy::key(std::size_t i) const {
+    if (!this->is_dictionary())
+        throw json_exception{"this is not a dictionary", json_errc::wrong_type};
+    children const &c = this->split();
+    if (i >= c.keys.size())
+        throw json_exception{"index out of range", json_errc::out_of_range};
+    return c.keys[i];
+}
+
+std::size_t json::lazy::size() const {
+    return this->split().values.size();
+}
+
+double json::lazy::get_number() const {
+    Token token;
+    if (!this->is_number())
+        throw json_exception{"this is not a number", json_errc::wrong_type};
+    if (!parse_number(this->range.data(), this->range.data() + this->range.size(), token))
+        throw json_exception{"numero non valido", json_errc::invalid_number};
+    return token.number;
+}
+
+std::int64_t json::lazy::get_integer() const {
+    Token token;
+    if (!this->is_number() || !parse_number(this->range.data(), this->range.data() + this->range.size(), token)
+        || !token.integral)
+        throw json_exception{"this is not an integer", json_errc::wrong_type};
+    return token.integer;
+}
+
+bool json::lazy::get_bool() const {
+    if (this->range == "true")
+        return true;
+    if (this->range == "false")
+        return false;
+    throw json_exception{"this is not a boolean", json_errc::wrong_type};
+}
+
+std::string_view json::lazy::get_string_view() const {
+    if (!this->is_string())
+        throw json_exception{"this is not a string", json_errc::wrong_type};
+    return this->range.substr(1, this->range.size() - 2);
+}
+
+std::string json::lazy::get_string() const {
+    std::string buffer;
+    std::string_view text = unescape(this->get_string_view(), buffer);
+    if (text.data() != buffer.data())
+        buffer.assign(text.data(), text.size());
+    return buffer;
+}
+
+std::string_view json::lazy::text() const {
+    return this->range;
+}
+
+json json::lazy::to_json() const {
+    return json::parse(this->range);
+}
+
+struct json::path::step {
+    std::string key;
+    uint64_t hash;
+    /* the key read as a list index, when it is one */
+    bool is_index;
+    std::size_t index;
+    bool wildcard;
+
+    bool matches(std::string_view k) const {
+        return this->wildcard || k == this->key;
+    }
+
+    bool matches(std::size_t i) const {
+        return this->wildcard || (this->is_index && i == this->index);
+    }
+};
+
+json::path::path(std::string_view pointer, mode m) : steps(nullptr), count(0) {
+    if (pointer.empty())
+        return;
+    if (pointer.front() != '/')
+        throw json_exception{"a json pointer starts with /", json_errc::invalid_pointer};
+    for (char c : pointer)
+        if (c == '/') ++this->count;
+    this->steps = new step[this->count];
+    std::size_t n = 0;
+    std::size_t at = 1;
+    while (true) {
+        std::size_t slash = pointer.find('/', at);
+        std::string_view token = pointer.substr(at, slash == std::string_view::npos ? std::string_view::npos : slash - at);
+        step &st = this->steps[n++];
+        for (std::size_t i = 0; i < token.size(); ++i) {
+            if (token[i] != '~') {
+                st.key += token[i];
+            } else if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+                st.key += token[++i] == '0' ? '~' : '/';
+            } else {
+                delete[] this->steps;
+                throw json_exception{"bad escape in json pointer: " + std::string(token), json_errc::invalid_pointer};
+            }
+        }
+        st.hash = dictionary_storage::hash(st.key);
+        st.wildcard = m == mode::wildcards && token == "*";
+        /* no leading zeros and no sign, as RFC 6901 wants */
+        st.is_index = !token.empty() && (token == "0" || token[0] != '0');
+        st.index = 0;
+        for (char c : token) {
+            if (!is_digit(c) || st.index > (std::numeric_limits<std::size_t>::max() - 9) / 10) {
+                st.is_index = false;
+                break;
+            }
+            st.index = st.index * 10 + (c - '0');
+        }
+        if (slash == std::string_view::npos)
+            break;
+        at = slash + 1;
+    }
+}
+
+json::path::path(path &&p) noexcept : steps(p.steps), count(p.count) {
+    p.steps = nullptr;
+    p.count = 0;
+}
+
+json::path::~path() {
+    delete[] this->steps;
+}
+
+json::path &json::path::operator=(path &&p) noexcept {
+    if (this != &p) {
+        delete[] this->steps;
+        this->steps = p.steps;
+        this->count = p.count;
+        p.steps = nullptr;
+        p.count = 0;
+    }
+    return *this;
+}
+
+/* Calls visit on every value under j matched by the steps from i on,
+   stopping as soon as visit returns false. With a non-const j, the
+   containers on the way are made ready to be changed. */
+template<class J, class Visit>
+static bool visit_path(J &j, json::path::step const *st, std::size_t left, Visit &visit) {
+    if (left == 0)
+        return visit(j);
+    if (j.is_dictionary()) {
+        if (!st->wildcard) {
+            auto entry = json_builder::entries_for(j).find(st->key, st->hash);
+            return entry == nullptr || visit_path(entry->second, st + 1, left - 1, visit);
+        }
+        for (auto it = j.begin_dictionary(); it != j.end_dictionary(); ++it)
+            if (!visit_path(it->second, st + 1, left - 1, visit))
+                return false;
+    } else if (j.is_list()) {
+        if (!st->wildcard) {
+            return !st->is_index || st->index >= j.size() || visit_path(j[st->index], st + 1, left - 1, visit);
+        }
+        for (auto it = j.begin_list(); it != j.end_list(); ++it)
+            if (!visit_path(*it, st + 1, left - 1, visit))
+                return false;
+    }
+    return true;
+}
+
+json const *json::path::find(json const &root) const {
+    json const *found = nullptr;
+    auto first = [&](json const &j) {
+        found = &j;
+        return false;
+    };
+    visit_path(root, this->steps, this->count, first);
+    return found;
+}
+
+json *json::path::find(json &root) const {
+    json *found = nullptr;
+    auto first = [&](json &j) {
+        found = &j;
+        return false;
+    };
+    visit_path(root, this->steps, this->count, first);
+    return found;
+}
+
+json json::path::select(json const &root) const {
+    json matches;
+    matches.set_list();
+    auto all = [&](json const &j) {
+        matches.push_back(j);
+        return true;
+    };
+    visit_path(root, this->steps, this->count, all);
+    return matches;
+}
+
+/*
+    Merge patches and diffs
+
+    merge_patch() follows RFC 7386 with the dictionary index: each key
+    of the patch is one probe, and a dictionary losing keys is compacted
+    once. diff() writes an RFC 6902 JSON Patch. It goes down both trees
+    together and stops at containers the two share, which copies made
+    from one another do until they change.
+*/
+
+/* Is x exactly the integer i? Rounding i to a double instead would
+   make 2^53 + 1 equal to 2^53. */
+static bool same_integer(std::int64_t i, double x) {
+    /* -2^63 <= x < 2^63, both bounds exact as doubles */
+    if (!(x >= -9223372036854775808.0 && x < 9223372036854775808.0))
+        return false;
+    std::int64_t truncated = static_cast<std::int64_t>(x);
+    return truncated == i && static_cast<double>(truncated) == x;
+}
+
+bool json::operator==(json const &j) const {
+    if (this->is_number() && j.is_number()) {
+        if (this->is_integer() && j.is_integer())
+            return this->get_integer() == j.get_integer();
+        if (this->is_integer())
+            return same_integer(this->get_integer(), j.get_number());
+        if (j.is_integer())
+            return same_integer(j.get_integer(), this->get_number());
+        return this->get_number() == j.get_number();
+    }
+    if (this->is_string() && j.is_string())
+        return this->get_string_view() == j.get_string_view();
+    if (this->tag != j.tag)
+        return false;
+    if (json_builder::same_storage(*this, j))
+        return true;
+    switch (this->tag) {
+        case kind::boolean:
+            return this->b == j.b;
+        case kind::list: {
+            if (this->size() != j.size())
+                return false;
+            const_list_iterator b = j.begin_list();
+            for (const_list_iterator a = this->begin_list(); a != this->end_list(); ++a, ++b)
+                if (*a != *b)
+                    return false;
+            return true;
+        }
+        case kind::dictionary: {
+            if (this->size() != j.size())
+                return false;
+            json_builder::dictionary &other = json_builder::entries(j);
+            for (const_dictionary_iterator a = this->begin_dictionary(); a != this->end_dictionary(); ++a) {
+                auto entry = other.find(a->first);
+                if (entry == nullptr || a->second != entry->second)
+                    return false;
+            }
+            return true;
+        }
+        default:
+            return true;  // null
+    }
+}
+
+bool json::operator!=(json const &j) const {
+    return !(*this == j);
+}
+
+/* merges patch into target, moving the values out of patch */
+static void merge_into(json &target, json &patch) {
+    if (!patch.is_dictionary()) {
+        target = std::move(patch);
+        return;
+    }
+    if (!target.is_dictionary())
+        target.set_dictionary();
+    json_builder::dictionary &d = json_builder::own_entries(target);
+    json_builder::dictionary &changes = json_builder::entries_for(patch);
+    vector<uint64_t> removed;
+    for (auto change = changes.items.begin(); change != changes.items.end(); ++change) {
+        auto entry = d.find(change->first);
+        if (change->second.is_null()) {
+            if (entry != nullptr)
+                removed.push_back(entry - d.items.begin());
+            continue;
+        }
+        if (entry == nullptr)
+            entry = &d.append(std::pair<std::string, json>(std::move(change->first), json()));
+        merge_into(entry->second, change->second);
+    }
+    /* the values may hold heap memory now */
+    d.pure = false;
+    std::sort(removed.begin(), removed.end());
+    d.erase(removed.begin(), removed.end());
+}
+
+void json::merge_patch(json const &patch) {
+    /* a copy shares what it can, and patch may be a part of *this */
+    json copy(patch);
+    merge_into(*this, copy);
+}
+
+void json::merge_patch(json &&patch) {
+    merge_into(*this, patch);
+}
+
+/* appends "/" and key to a JSON Pointer, escaped as RFC 6901 says */
+static void append_token(std::string &pointer, std::string_view key) {
+    pointer += '/';
+    for (char c : key) {
+        if (c == '~')
+            pointer += "~0";
+        else if (c == '/')
+            pointer += "~1";
+        else
+            pointer += c;
+    }
+}
+
+static void add_operation(json &patch, const char *op, std::string const &pointer, json const *value) {
+    json &operation = patch.emplace_back();
+    operation.set_dictionary();
+    operation.emplace("op").set_string(op);
+    operation.emplace("path").set_string(pointer);
+    if (value != nullptr)
+        operation.emplace("value") = *value;
+}
+
+/* appends to patch the operations turning from into to, both at pointer */
+static void diff_into(json const &from, json const &to, std::string &pointer, json &patch) {
+    if (json_builder::same_storage(from, to))
+        return;
+    std::size_t length = pointer.size();
+    if (from.is_dictionary() && to.is_dictionary()) {
+        json_builder::dictionary &after = json_builder::entries(to);
+        for (json::const_dictionary_iterator it = from.begin_dictionary(); it != from.end_dictionary(); ++it) {
+            append_token(pointer, it->first);
+            if (auto entry = after.find(it->first))
+                diff_into(it->second, entry->second, pointer, patch);
+            else
+                add_operation(patch, "remove", pointer, nullptr);
+            pointer.resize(length);
+        }
+        json_builder::dictionary &before = json_builder::entries(from);
+        for (json::const_dictionary_iterator it = to.begin_dictionary(); it != to.end_dictionary(); ++it) {
+            if (before.find(it->first) != nullptr)
+                continue;
+            append_token(pointer, it->first);
+            add_operation(patch, "add", pointer, &it->second);
+            pointer.resize(length);
+        }
+    } else if (from.is_list() && to.is_list()) {
+        std::size_t common = std::min(from.size(), to.size());
+        for (std::size_t i = 0; i < common; ++i) {
+            append_token(pointer, std::to_string(i));
+            diff_into(from[i], to[i], pointer, patch);
+            pointer.resize(length);
+        }
+        for (std::size_t i = common; i < to.size(); ++i) {
+            append_token(pointer, std::to_string(i));
+            add_operation(patch, "add", pointer, &to[i]);
+            pointer.resize(length);
+        }
+        /* from the end, so the indexes still to remove stay put */
+        for (std::size_t i = from.size(); i-- > common;) {
+            append_token(pointer, std::to_string(i));
+            add_operation(patch, "remove", pointer, nullptr);
+            pointer.resize(length);
+        }
+    } else if (from != to) {
+        add_operation(patch, "replace", pointer, &to);
+    }
+}
+
+json json::diff(json const &from, json const &to) {
+    json patch;
+    patch.set_list();
+    std::string pointer;
+    diff_into(from, to, pointer, patch);
+    return patch;
+}
+
+/* Passes on to h only the events of the values matched by the steps.
+   The open containers are tracked on a stack: the ones on the way to a
+   match form its bottom, prefix of them. */
+template<class Handler>
+class path_filter {
+public:
+    path_filter(json::path::step const *steps, std::size_t count, Handler &h) : steps(steps), count(count), h(h) {}
+
+    void on_null() {
+        if (this->scalar())
+            this->h.on_null();
+    }
+
+    void on_boolean(bool value) {
+        if (this->scalar())
+            this->h.on_boolean(value);
+    }
+
+    void on_number(double value) {
+        if (this->scalar())
+            this->h.on_number(value);
+    }
+
+    void on_integer(std::int64_t value) {
+        if (this->scalar())
+            this->h.on_integer(value);
+    }
+
+    void on_string(std::string_view text) {
+        if (this->scalar())
+            this->h.on_string(text);
+    }
+
+    void on_key(std::string_view key) {
+        if (this->inside != 0) {
+            this->h.on_key(key);
+        } else if (this->open.size() == this->prefix) {
+            frame &f = *this->open.back();
+            f.key_match = this->steps[this->prefix - 1].matches(key);
+        }
+    }
+
+    void on_start_object() {
+        this->start(false);
+    }
+
+    void on_end_object() {
+        this->end(false);
+    }
+
+    void on_start_array() {
+        this->start(true);
+    }
+
+    void on_end_array() {
+        this->end(true);
+    }
+
+private:
+    struct frame {
+        bool list;
+        bool key_match;
+        std::size_t index;  // of the next element of a list
+    };
+
+    /* does the value about to start match the whole path? the steps up
+       to the top container match when prefix == open.size() */
+    int classify() {
+        std::size_t depth = this->open.size();
+        bool on_path = depth == this->prefix;
+        if (on_path && depth > 0) {
+            frame &f = *this->open.back();
+            json::path::step const &st = this->steps[depth - 1];
+            on_path = f.list ? st.matches(f.index) : f.key_match;
+        }
+        if (depth > 0 && this->open.back()->list)
+            ++this->open.back()->index;
+        if (!on_path)
+            return 0;
+        return depth == this->count ? 2 : 1;  // 2: matched, 1: on the way
+    }
+
+    bool scalar() {
+        if (this->inside != 0)
+            return true;
+        return this->classify() == 2;
+    }
+
+    void start(bool list) {
+        if (this->inside != 0) {
+            ++this->inside;
+        } else {
+            int c = this->classify();
+            if (c == 2)
+                this->inside = 1;
+            else if (c == 1)
+                this->prefix = this->open.size() + 1;
+        }
+        this->open.push_back(frame{list, false, 0});
+        if (this->inside != 0) {
+            if (list)
+                this->h.on_start_array();
+            else
+                this->h.on_start_object();
+        }
+    }
+
+    void end(bool list) {
+        if (this->inside != 0) {
+            --this->inside;
+            if (list)
+                this->h.on_end_array();
+            else
+                this->h.on_end_object();
+        }
+        if (this->prefix == this->open.size())
+            --this->prefix;
+        this->open.pop_back();
+    }
+
+    json::path::step const *steps;
+    std::size_t count;
+    Handler &h;
+    vector<frame> open;
+    std::size_t prefix = 0;
+    /* depth inside a matched container, 0 outside of any */
+    std::size_t inside = 0;
+};
+
+json json::path::extract(std::string_view input) const {
+    tree_builder b(nullptr, std::string_view());
+    b.on_start_array();
+    path_filter<tree_builder> filter(this->steps, this->count, b);
+    parse_events(input, filter);
+    b.on_end_array();
+    return std::move(b.root());
+}
+
+void json::path::extract(std::string_view input, handler &h) const {
+    path_filter<handler> filter(this->steps, this->count, h);
+    parse_events(input, filter);
+}
+
+/* Fills a C++ value through its binding as the events of the json
+   text come, see json::decode(). The value of a key that is no field
+   is skipped over by the parser, see skip_member(). */
+class binding_decoder {
+public:
+    binding_decoder(void *target, json::binding const &b) : root(target), root_binding(&b) {}
+
+    void on_null() {
+        json::binding const *b;
+        void *t = this->next(b, true);
+        if (!b->on_null)
+            mismatch("null");
+        b->on_null(t);
+    }
+
+    void on_boolean(bool value) {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->on_boolean)
+            mismatch("boolean");
+        b->on_boolean(t, value);
+    }
+
+    void on_number(double value) {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->on_number)
+            mismatch("number");
+        b->on_number(t, value);
+    }
+
+    void on_integer(std::int64_t value) {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->on_integer)
+            mismatch("number");
+        b->on_integer(t, value);
+    }
+
+    void on_string(std::string_view text) {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->on_string)
+            mismatch("string");
+        b->on_string(t, text);
+    }
+
+    void on_key(std::string_view key) {
+        frame &f = *this->open.back();
+        this->pending = f.b->member(f.target, key, &this->pending_binding);
+    }
+
+    /* the key just read is no field */
+    bool skip_member() const {
+        return !this->pending;
+    }
+
+    void on_start_object() {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->member)
+            mismatch("dictionary");
+        this->open.push_back(frame{t, b});
+    }
+
+    void on_start_array() {
+        json::binding const *b;
+        void *t = this->next(b, false);
+        if (!b->element)
+            mismatch("list");
+        b->clear(t);
+        this->open.push_back(frame{t, b});
+    }
+
+    void on_end_object() {
+        this->open.pop_back();
+    }
+
+    void on_end_array() {
+        this->open.pop_back();
+    }
+
+private:
+    struct frame {
+        void *target;
+        json::binding const *b;
+    };
+
+    [[noreturn]] static void mismatch(const char *what) {
+        throw json_exception{std::string("a ") + what + " does not match the type it is decoded into", json_errc::wrong_type};
+    }
+
+    /* where the value about to start goes, and its binding in b; a null
+       stops at an optional, anything else makes it present */
+    void *next(json::binding const *&b, bool null) {
+        void *t;
+        if (this->open.empty()) {
+            t = this->root;
+            b = this->root_binding;
+        } else {
+            frame &f = *this->open.back();
+            if (f.b->element) {
+                t = f.b->element(f.target, &b);
+            } else {
+                t = this->pending;
+                b = this->pending_binding;
+            }
+        }
+        while (b->unwrap && !(null && b->on_null))
+            t = b->unwrap(t, &b);
+        return t;
+    }
+
+    void *root;
+    json::binding const *root_binding;
+    vector<frame> open;
+    /* the member named by the last key */
+    void *pending = nullptr;
+    json::binding const *pending_binding = nullptr;
+};
+
+void json::decode_into(std::string_view input, void *target, binding const &b) {
+    binding_decoder d(target, b);
+    parse_events(input, d);
+}
+
+/*
+    Columns
+
+    The records are read as events, like by decode(), each value going
+    to the back of the buffers of its column. Records with the same
+    keys in the same order are the common case, so the column after the
+    one of the previous key is tried first, then a hash table of the
+    names. A column only catches up with the rows it missed, as nulls,
+    when its next value comes or at the end of the input.
+*/
+
+class column_decoder {
+public:
+    using column = json::columns::column;
+    using type = json::columns::type;
+
+    /* the columns of a type other than null keep it */
+    column_decoder(std::vector<column> &cols, bool detect) : cols(cols), detect(detect) {
+        for (column &c : cols)
+            this->state.push_back(track{0, c.kind != type::null});
+        this->rehash();
+    }
+
+    void on_null() {
+        column &c = this->start();
+        this->append_null(c);
+    }
+
+    void on_boolean(bool value) {
+        column &c = this->start();
+        this->settle(c, type::boolean);
+        push_bit(c.bits, this->row(), value);
+        this->filled();
+    }
+
+    void on_integer(std::int64_t value) {
+        column &c = this->start();
+        if (c.kind == type::number) {
+            c.numbers.push_back(static_cast<double>(value));
+        } else {
+            this->settle(c, type::integer);
+            c.integers.push_back(value);
+        }
+        this->filled();
+    }
+
+    void on_number(double value) {
+        column &c = this->start();
+        if (c.kind == type::integer && this->state[this->current].fixed) {
+            /* 2^63 is exact as a double, INT64_MAX is not */
+            if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)
+                    || static_cast<double>(static_cast<std::int64_t>(value)) != value)
+                throw json_exception{"number that is not an integer in the integer column " + c.name, json_errc::wrong_type};
+            c.integers.push_back(static_cast<std::int64_t>(value));
+        } else {
+            this->settle(c, type::number);
+            c.numbers.push_back(value);
+        }
+        this->filled();
+    }
+
+    void on_string(std::string_view text) {
+        column &c = this->start();
+        this->settle(c, type::string);
+        c.data.append(text.data(), text.size());
+        c.offsets.push_back(static_cast<std::int64_t>(c.data.size()));
+        this->filled();
+    }
+
+    void on_key(std::string_view key) {
+        this->current = this->find(key);
+        if (this->current == none && this->detect) {
+            this->current = this->cols.size();
+            this->cols.push_back(column());
+            this->cols.back().name.assign(key.data(), key.size());
+            this->state.push_back(track{0, false});
+            this->rehash();
+        }
+        this->next = this->current == none ? 0 : this->current + 1;
+    }
+
+    /* the key just read names no declared column */
+    bool skip_member() const {
+        return this->current == none;
+    }
+
+    void on_start_array() {
+        if (this->depth != 0)
+            this->not_records();
+        ++this->depth;
+    }
+
+    void on_end_array() {
+        --this->depth;
+    }
+
+    void on_start_object() {
+        if (this->depth != 1)
+            this->not_records();
+        ++this->depth;
+        this->next = 0;
+    }
+
+    void on_end_object() {
+        --this->depth;
+        ++this->rows;
+    }
+
+    /* brings every column to the last row, returns the number of rows */
+    std::size_t finish() {
+        for (std::size_t i = 0; i != this->cols.size(); ++i) {
+            this->current = i;
+            this->pad(this->cols[i]);
+        }
+        return this->rows;
+    }
+
+private:
+    static constexpr std::size_t none = ~std::size_t(0);
+
+    struct track {
+        std::size_t rows;  // of the column filled so far
+        bool fixed;        // the type was declared
+    };
+
+    [[noreturn]] void not_records() const {
+        if (this->depth == 2)
+            throw json_exception{"a value in column " + this->cols[this->current].name + " that is not a scalar", json_errc::wrong_type};
+        throw json_exception{"the json value is not a list of records", json_errc::wrong_type};
+    }
+
+    static void push_bit(std::vector<std::uint8_t> &bits, std::size_t i, bool value) {
+        if (i % 8 == 0)
+            bits.push_back(0);
+        bits[i / 8] |= static_cast<std::uint8_t>(value) << (i % 8);
+    }
+
+    static bool pop_bit(std::vector<std::uint8_t> &bits, std::size_t i) {
+        bool value = (bits[i / 8] >> (i % 8)) & 1;
+        bits[i / 8] &= static_cast<std::uint8_t>(~(1u << (i % 8)));
+        if (i % 8 == 0)
+            bits.pop_back();
+        return value;
+    }
+
+    /* the row the next value of the current column goes to */
+    std::size_t row() const {
+        return this->state[this->current].rows;
+    }
+
+    /* the column of the value about to be read, up to the current row */
+    column &start() {
+        if (this->depth != 2)
+            this->not_records();
+        column &c = this->cols[this->current];
+        if (this->row() > this->rows)
+            this->drop_last(c);
+        this->pad(c);
+        return c;
+    }
+
+    /* the value has gone into its buffer, marks it valid */
+    void filled() {
+        column &c = this->cols[this->current];
+        push_bit(c.validity, this->state[this->current].rows++, true);
+    }
+
+    void append_null(column &c) {
+        std::size_t i = this->state[this->current].rows++;
+        push_bit(c.validity, i, false);
+        ++c.null_count;
+        switch (c.kind) {
+            case type::boolean:
+                push_bit(c.bits, i, false);
+                break;
+            case type::integer:
+                c.integers.push_back(0);
+                break;
+            case type::number:
+                c.numbers.push_back(0);
+                break;
+            case type::string:
+                c.offsets.push_back(static_cast<std::int64_t>(c.data.size()));
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* nulls in the rows of the records that had no value for c */
+    void pad(column &c) {
+        while (this->row() < this->rows)
+            this->append_null(c);
+    }
+
+    /* forgets the value of the current row, for a repeated key */
+    void drop_last(column &c) {
+        std::size_t i = --this->state[this->current].rows;
+        if (!pop_bit(c.validity, i))
+            --c.null_count;
+        switch (c.kind) {
+            case type::boolean:
+                pop_bit(c.bits, i);
+                break;
+            case type::integer:
+                c.integers.pop_back();
+                break;
+            case type::number:
+                c.numbers.pop_back();
+                break;
+            case type::string:
+                c.offsets.pop_back();
+                c.data.resize(static_cast<std::size_t>(c.offsets.back()));
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* makes c a column of type t, if its values so far allow it */
+    void settle(column &c, type t) {
+        if (c.kind == t)
+            return;
+        std::size_t n = this->row();
+        if (c.kind == type::null) {
+            /* the rows so far are all null */
+            c.kind = t;
+            if (t == type::boolean)
+                c.bits.assign((n + 7) / 8, 0);
+            else if (t == type::integer)
+                c.integers.assign(n, 0);
+            else if (t == type::number)
+                c.numbers.assign(n, 0);
+            else
+                c.offsets.assign(n + 1, 0);
+            return;
+        }
+        if (c.kind == type::integer && t == type::number && !this->state[this->current].fixed) {
+            c.kind = type::number;
+            c.numbers.reserve(c.integers.capacity());
+            for (std::int64_t x : c.integers)
+                c.numbers.push_back(static_cast<double>(x));
+            c.integers.clear();
+            return;
+        }
+        static const char *const names[] = {"null", "boolean", "integer", "number", "string"};
+        throw json_exception{std::string("a ") + names[static_cast<int>(t)] + " in the " + names[static_cast<int>(c.kind)]
+                                     + " column " + c.name,
+                             json_errc::wrong_type};
+    }
+
+    /* the column named key, none if there is no such column */
+    std::size_t find(std::string_view key) const {
+        if (this->next < this->cols.size() && this->cols[this->next].name == key)
+            return this->next;
+        if (this->slots.empty())
+            return none;
+        std::size_t mask = this->slots.size() - 1;
+        for (std::size_t i = std::hash<std::string_view>{}(key) & mask;; i = (i + 1) & mask) {
+            uint32_t slot = this->slots[i];
+            if (slot == 0)
+                return none;
+            if (this->cols[slot - 1].name == key)
+                return slot - 1;
+        }
+    }
+
+    /* the table of names, at most half full */
+    void rehash() {
+        std::size_t size = 1;
+        while (size < 2 * this->cols.size())
+            size *= 2;
+        this->slots.clear();
+        for (std::size_t i = 0; i != size; ++i)
+            this->slots.push_back(0);
+        std::size_t mask = size - 1;
+        for (std::size_t c = 0; c != this->cols.size(); ++c) {
+            std::size_t i = std::hash<std::string_view>{}(this->cols[c].name) & mask;
+            while (this->slots[i] != 0)
+                i = (i + 1) & mask;
+            this->slots[i] = static_cast<uint32_t>(c + 1);
+        }
+    }
+
+    std::vector<column> &cols;
+    bool detect;
+    vector<track> state;
+    vector<uint32_t> slots;
+    std::size_t current = none;
+    /* the column tried first for the next key */
+    std::size_t next = 0;
+    std::size_t depth = 0;
+    std::size_t rows = 0;
+};
+
+json::columns::columns() : detect(true) {}
+
+json::columns::columns(std::vector<std::pair<std::string, type>> schema) : schema(std::move(schema)), detect(false) {}
+
+/* back to the columns of schema without rows, keeping their buffers */
+static void reset_columns(std::vector<json::columns::column> &cols,
+                          std::vector<std::pair<std::string, json::columns::type>> const &schema) {
+    cols.resize(schema.size());
+    for (std::size_t i = 0; i != schema.size(); ++i) {
+        json::columns::column &c = cols[i];
+        c.name = schema[i].first;
+        c.kind = schema[i].second;
+        c.null_count = 0;
+        c.validity.clear();
+        c.bits.clear();
+        c.integers.clear();
+        c.numbers.clear();
+        c.offsets.clear();
+        c.data.clear();
+        if (c.kind == json::columns::type::string)
+            c.offsets.push_back(0);
+    }
+}
+
+void json::columns::parse(std::string_view input) {
+    reset_columns(this->cols, this->schema);
+    this->count = 0;
+    column_decoder d(this->cols, this->detect);
+    try {
+        parse_events(input, d);
+    } catch (...) {
+        reset_columns(this->cols, this->schema);
+        throw;
+    }
+    this->count = d.finish();
+}
+
+void json::columns::parse_file(std::string const &path) {
+    mapped_file file(path);
+    this->parse(file.view());
+}
+
+std::size_t json::columns::rows() const {
+    return this->count;
+}
+
+std::size_t json::columns::size() const {
+    return this->cols.size();
+}
+
+json::columns::column const &json::columns::operator[](std::size_t i) const {
+    if (i >= this->cols.size())
+        throw json_exception{"no column at this index", json_errc::out_of_range};
+    return this->cols[i];
+}
+
+json::columns::column const &json::columns::operator[](std::string_view name) const {
+    for (column const &c : this->cols)
+        if (c.name == name)
+            return c;
+    throw json_exception{"no column " + std::string(name), json_errc::not_found};
+}
+
+/* A fixed set of worker threads running the iterations of parallel
+   loops, the calling thread taking its share too. */
+class thread_pool {
+public:
+    /* threads == 0 means one per core */
+    explicit thread_pool(unsigned threads) {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        for (unsigned i = 1; i < threads; ++i)
+            this->workers.push_back(std::thread([this] { this->work(); }));
+    }
+
+    thread_pool(thread_pool const &) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+            this->stop = true;
+        }
+        this->wake.notify_all();
+        for (std::thread &t : this->workers)
+            t.join();
+    }
+
+    thread_pool &operator=(thread_pool const &) = delete;
+
+    /* Calls task(i) for every i in [0, n) and returns once all calls are
+       over. What a call throws, on any thread, is thrown again here
+       then, the first exception caught if there are several. */
+    void run(std::size_t n, std::function<void(std::size_t)> const &task) {
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+            this->task = &task;
+            this->count = n;
+            this->next = 0;
+            this->busy = this->workers.size();
+            ++this->generation;
+        }
+        this->wake.notify_all();
+        this->take_tasks();
+        std::unique_lock<std::mutex> lock(this->m);
+        this->done.wait(lock, [this] { return this->busy == 0; });
+        this->task = nullptr;
+        std::exception_ptr e = std::move(this->failure);
+        this->failure = nullptr;
+        lock.unlock();
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+private:
+    void take_tasks() {
+        std::size_t i;
+        while ((i = this->next.fetch_add(1, std::memory_order_relaxed)) < this->count) {
+            try {
+                (*this->task)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(this->m);
+                if (!this->failure)
+                    this->failure = std::current_exception();
+            }
+        }
+    }
+
+    void work() {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(this->m);
+                this->wake.wait(lock, [&] { return this->stop || this->generation != seen; });
+                if (this->stop)
+                    return;
+                seen = this->generation;
+            }
+            this->take_tasks();
+            std::lock_guard<std::mutex> lock(this->m);
+            if (--this->busy == 0)
+                this->done.notify_one();
+        }
+    }
+
+    vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(std::size_t)> const *task = nullptr;
+    /* the first exception thrown by a call of task */
+    std::exception_ptr failure;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next{0};
+    /* workers that have not finished the current loop yet */
+    std::size_t busy = 0;
+    uint64_t generation = 0;
+    bool stop = false;
+};
+
+/* The events of one value, kept to be reported later: a thread of
+   ndjson_reader records a line, the calling thread replays it to the
+   handler. Strings and keys are copied one after the other into text,
+   numbers and booleans are held in the event itself. */
+class event_tape {
+public:
+    void on_null() { this->add(event_kind::null, 0); }
+    void on_boolean(bool b) { this->add(event_kind::boolean, b); }
+    void on_number(double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof bits);
+        this->add(event_kind::number, bits);
+    }
+    void on_integer(std::int64_t value) { this->add(event_kind::integer, static_cast<uint64_t>(value)); }
+    void on_string(std::string_view s) { this->add_text(event_kind::string, s); }
+    void on_key(std::string_view s) { this->add_text(event_kind::key, s); }
+    void on_start_object() { this->add(event_kind::start_object, 0); }
+    void on_end_object() { this->add(event_kind::end_object, 0); }
+    void on_start_array() { this->add(event_kind::start_array, 0); }
+    void on_end_array() { this->add(event_kind::end_array, 0); }
+
+    /* forgets the events, keeps the memory */
+    void clear() {
+        this->events.clear();
+        this->text.clear();
+    }
+
+    /* reports the events to h in the order they came */
+    void replay(json::handler &h) const {
+        for (auto it = this->events.cbegin(); it != this->events.cend(); ++it) {
+            switch (it->kind) {
+                case event_kind::null:
+                    h.on_null();
+                    break;
+                case event_kind::boolean:
+                    h.on_boolean(it->value != 0);
+                    break;
+                case event_kind::number: {
+                    double x;
+                    std::memcpy(&x, &it->value, sizeof x);
+                    h.on_number(x);
+                    break;
+                }
+                case event_kind::integer:
+                    h.on_integer(static_cast<std::int64_t>(it->value));
+                    break;
+                case event_kind::string:
+                    h.on_string(std::string_view(this->text.data() + it->value, it->size));
+                    break;
+                case event_kind::key:
+                    h.on_key(std::string_view(this->text.data() + it->value, it->size));
+                    break;
+                case event_kind::start_object:
+                    h.on_start_object();
+                    break;
+                case event_kind::end_object:
+                    h.on_end_object();
+                    break;
+                case event_kind::start_array:
+                    h.on_start_array();
+                    break;
+                case event_kind::end_array:
+                    h.on_end_array();
+                    break;
+            }
+        }
+    }
+
+private:
+    enum class event_kind : uint8_t {
+        null, boolean, number, integer, string, key, start_object, end_object, start_array, end_array,
+    };
+
+    struct event {
+        event_kind kind;
+        std::size_t size;  // of a string or key
+        /* the bits of the number, or where text holds the string */
+        uint64_t value;
+    };
+
+    void add(event_kind kind, uint64_t value) {
+        this->events.push_back(event{kind, 0, value});
+    }
+
+    void add_text(event_kind kind, std::string_view s) {
+        this->events.push_back(event{kind, s.size(), this->text.size()});
+        this->text.append(s.data(), s.size());
+    }
+
+    vector<event> events;
+    std::string text;
+};
+
+struct json::ndjson_reader::state {
+    /* lines handed to a thread at a time */
+    static constexpr std::size_t lines_per_task = 64;
+
+    state(std::istream &input, unsigned threads, std::size_t batch_size)
+            : sb(input.rdbuf()), pool(threads), batch_size(batch_size > 0 ? batch_size : 1) {
+        if (this->sb == nullptr)
+            throw json_exception{"stream without a buffer", json_errc::io_error};
+    }
+
+    /* Parses the next batch into records, or into tapes as events,
+       false at the end of input. */
+    bool next_batch(bool events);
+
+    /* reads whole lines into [0, complete) of buffer */
+    bool fill();
+
+    std::streambuf *sb;
+    thread_pool pool;
+    std::size_t batch_size;
+    std::string buffer;
+    std::size_t used = 0;      // bytes read into buffer
+    std::size_t complete = 0;  // bytes of buffer ending with a whole line
+    std::size_t offset = 0;    // bytes of the input before buffer
+    bool eof = false;
+    /* lines consumed before the current batch */
+    uint64_t line = 0;
+    vector<std::string_view> lines;
+    vector<uint64_t> numbers;  // line number of every record
+    vector<json> records;
+    /* the events of every record, when read by a handler */
+    vector<event_tape> tapes;
+};
+
+bool json::ndjson_reader::state::fill() {
+    /* keep the incomplete last line of the previous batch */
+    this->offset += this->complete;
+    this->buffer.erase(0, this->complete);
+    this->used -= this->complete;
+    this->complete = 0;
+    while (true) {
+        std::size_t from = this->used;
+        if (!this->eof) {
+            if (this->buffer.size() < this->used + this->batch_size)
+                this->buffer.resize(this->used + this->batch_size);
+            std::streamsize n = this->sb->sgetn(&this->buffer[this->used], this->buffer.size() - this->used);
+            if (n <= 0)
+                this->eof = true;
+            else
+                this->used += n;
+        }
+        for (std::size_t i = this->used; i > from; --i) {
+            if (this->buffer[i - 1] == '\n') {
+                this->complete = i;
+                return true;
+            }
+        }
+        if (this->eof) {
+            this->complete = this->used;
+            return this->used > 0;
+        }
+        /* a line longer than the batch, read on */
+    }
+}
+
+bool json::ndjson_reader::state::next_batch(bool events) {
+    while (this->fill()) {
+        this->lines.clear();
+        this->numbers.clear();
+        const char *p = this->buffer.data();
+        const char *end = p + this->complete;
+        while (p != end) {
+            const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            if (eol == nullptr) eol = end;
+            ++this->line;
+            for (const char *c = p; c != eol; ++c) {
+                if (*c != ' ' && *c != '\t' && *c != '\r') {
+                    this->lines.push_back(std::string_view(p, eol - p));
+                    this->numbers.push_back(this->line);
+                    break;
+                }
+            }
+            p = eol != end ? eol + 1 : end;
+        }
+        std::size_t n = this->lines.size();
+        if (n == 0)
+            continue;
+
+        if (events) {
+            /* the tapes of the last batch keep their memory */
+            for (std::size_t i = 0; i < n && i < this->tapes.size(); ++i)
+                this->tapes[i].clear();
+            while (this->tapes.size() < n)
+                this->tapes.push_back(event_tape());
+        } else {
+            this->records.clear();
+            this->records.reserve(n);
+            for (std::size_t i = 0; i < n; ++i)
+                this->records.push_back(json());
+        }
+        std::mutex error_lock;
+        std::size_t error_at = n;
+        json_exception error;
+        this->pool.run((n + lines_per_task - 1) / lines_per_task, [&](std::size_t task) {
+            std::size_t last = std::min(n, (task + 1) * lines_per_task);
+            for (std::size_t i = task * lines_per_task; i < last; ++i) {
+                try {
+                    if (events)
+                        parse_events(this->lines[i], this->tapes[i]);
+                    else
+                        this->records[i] = json::parse(this->lines[i]);
+                } catch (json_exception &e) {
+                    std::lock_guard<std::mutex> lock(error_lock);
+                    if (i < error_at) {
+                        error_at = i;
+                        error = std::move(e);
+                    }
+                    return;
+                }
+            }
+        });
+        if (error_at != n) {
+            /* the position is within the line, make it one in the input */
+            error.msg = "line " + std::to_string(this->numbers[error_at]) + ": " + error.msg;
+            error.offset += this->offset + (this->lines[error_at].data() - this->buffer.data());
+            error.line = this->numbers[error_at];
+            throw error;
+        }
+        return true;
+    }
+    return false;
+}
+
+json::ndjson_reader::ndjson_reader(std::istream &input, unsigned threads, std::size_t batch_size)
+        : st(new state(input, threads, batch_size)) {}
+
+json::ndjson_reader::~ndjson_reader() {
+    delete this->st;
+}
+
+bool json::ndjson_reader::read(json &batch) {
+    if (!this->st->next_batch(false))
+        return false;
+    batch.set_list();
+    batch.reserve(this->st->records.size());
+    for (json &record : this->st->records)
+        batch.push_back(std::move(record));
+    return true;
+}
+
+bool json::ndjson_reader::read(handler &h) {
+    if (!this->st->next_batch(true))
+        return false;
+    for (std::size_t i = 0; i < this->st->lines.size(); ++i)
+        this->st->tapes[i].replay(h);
+    return true;
+}
+
+/* A list with fewer elements is left to the serial parser. */
+static constexpr std::size_t parallel_min_elements = 64;
+
+/* The threads of parse_parallel(), started by the first call and kept
+   for the next ones; a call asking for another number of threads
+   replaces them. One call uses the pool at a time. */
+struct parallel_pool {
+    std::mutex m;
+    std::unique_ptr<thread_pool> pool;
+    unsigned threads = 0;
+
+    static parallel_pool &shared() {
+        static parallel_pool p;
+        return p;
+    }
+};
+
+/* Parses a top level list in two phases. The structural index tells
+   where every element begins, counting only the commas outside nested
+   containers; then slices of about the same number of tokens are
+   parsed by the threads of a pool straight into their slots of the
+   list. Anything else, or an input the index cannot cover, goes through
+   the serial parser, which also reports the syntax errors; so does a
+   list with fewer slices than threads, and any list when there is one
+   thread or the pool is taken by another call. */
+static json parse_list_parallel(std::string_view input, unsigned threads) {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads <= 1 || input.size() < structural_index_min_size || input.size() > UINT32_MAX)
+        return parse_value(input, nullptr, false);
+    vector<uint32_t> index = build_structural_index(input);
+    std::size_t n = index.size();
+    if (n < 2 || input[index[0]] != '[' || input[index[n - 1]] != ']')
+        return parse_value(input, nullptr, false);
+
+    /* element k spans the tokens [starts[k], starts[k + 1] - 1) */
+    vector<uint32_t> starts;
+    starts.push_back(1);
+    long depth = 0;
+    for (std::size_t i = 1; i + 1 < n && depth >= 0; ++i) {
+        char c = input[index[i]];
+        if (c == '{' || c == '[')
+            ++depth;
+        else if (c == '}' || c == ']')
+            --depth;
+        else if (c == ',' && depth == 0)
+            starts.push_back(static_cast<uint32_t>(i + 1));
+    }
+    if (depth != 0 || starts.size() < parallel_min_elements)
+        return parse_value(input, nullptr, false);
+    std::size_t slots = starts.size();
+    starts.push_back(static_cast<uint32_t>(n));
+
+    /* The list itself goes through the grammar of the serial parser, as
+       elements that are there or not: an empty one is only allowed where
+       the grammar skips it, as in [1,], and an error is left to the
+       serial parser, which reports it where it is. */
+    vector<uint32_t> elements;  // the slots holding an element
+    try {
+        grammar_state s = grammar_state::list_first;
+        for (std::size_t k = 0; k < slots; ++k) {
+            if (starts[k + 1] - 1 != starts[k]) {
+                advance(s, grammar_symbol::name);
+                elements.push_back(static_cast<uint32_t>(k));
+            }
+            advance(s, k + 1 < slots ? grammar_symbol::comma : grammar_symbol::close_list);
+        }
+    } catch (json_exception &) {
+        return parse_value(input, nullptr, false);
+    }
+    std::size_t count = elements.size();
+    /* a few slices per thread even out elements of different sizes */
+    std::size_t slices = std::min<std::size_t>(count, std::size_t(threads) * 8);
+    std::size_t tokens_per_slice = (n - 1) / slices + 1;
+    vector<uint32_t> bounds;  // first element of every slice
+    bounds.push_back(0);
+    for (std::size_t k = 1; k < count; ++k)
+        if (starts[elements[k]] - starts[elements[*bounds.back()]] >= tokens_per_slice)
+            bounds.push_back(static_cast<uint32_t>(k));
+    bounds.push_back(static_cast<uint32_t>(count));
+    if (bounds.size() - 1 < threads)
+        return parse_value(input, nullptr, false);
+
+    parallel_pool &shared = parallel_pool::shared();
+    std::unique_lock<std::mutex> taken(shared.m, std::try_to_lock);
+    if (!taken.owns_lock())
+        return parse_value(input, nullptr, false);
+    if (shared.threads != threads) {
+        shared.pool.reset();
+        shared.pool.reset(new thread_pool(threads));
+        shared.threads = threads;
+    }
+
+    stat_timer timer(stat_id::parse_ns);
+    count_stat(stat_id::documents);
+    count_stat(stat_id::bytes, input.size());
+    /* the slices only read the tokens of the elements */
+    count_stat(stat_id::open_bracket);
+    count_stat(stat_id::close_bracket);
+    count_stat(stat_id::comma, slots - 1);
+
+    json j;
+    json_builder::set_list(j, nullptr);
+    vector<json> &items = json_builder::items(j);
+    items.reserve(count);
+    for (std::size_t k = 0; k < count; ++k)
+        items.push_back(json());
+
+    std::mutex error_lock;
+    std::size_t error_at = count;
+    json_exception error;
+    shared.pool->run(bounds.size() - 1, [&](std::size_t slice) {
+        for (std::size_t k = bounds[slice]; k < bounds[slice + 1]; ++k) {
+            std::size_t e = elements[k];
+            Tokenizer t(input, index.begin() + starts[e], index.begin() + starts[e + 1] - 1);
+            try {
+                tree_builder b(nullptr, std::string_view());
+                Token token = t.get_token();
+                /* inside the list, as for the serial parser */
+                get_json_value(token, t, b, 1);
+                Token next = t.get_token();
+                if (next.type != TOKEN::FINE_INPUT) {
+                    /* another value before the next comma: the error of the grammar */
+                    grammar_symbol symbol = symbol_of(next);
+                    grammar_state s = grammar_state::list_element;
+                    advance(s, symbol);
+                    /* only a comma or a bracket gets by, none is left in a slice */
+                    throw grammar_error(grammar_action::invalid, symbol);
+                }
+                items[k] = std::move(b.root());
+            } catch (json_exception &e) {
+                t.locate(e);
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (k < error_at) {
+                    error_at = k;
+                    error = std::move(e);
+                }
+                return;
+            }
+        }
+    });
+    if (error_at != count) {
+        error.msg = "element " + std::to_string(error_at) + ": " + error.msg;
+        throw error;
+    }
+    return j;
+}
+
+json json::parse_parallel(std::string_view input, unsigned threads) {
+    return parse_list_parallel(input, threads);
+}
+
+json json::parse_file_parallel(std::string const &path, unsigned threads) {
+    mapped_file file(path);
+    return parse_list_parallel(file.view(), threads);
+}
+
+/* left out when json.cpp is built into another program, see bench.cpp */
+#ifndef JSON_NO_MAIN
+int main() {
+    //here you can test the parser
+
+    return 0;
+}
+#endif
+
+
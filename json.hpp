@@ -1,11 +1,51 @@
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
 #include <limits>
 #include <assert.h>
 #include <fstream>
+#include <array>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+/* what made an operation fail, see json_exception */
+enum class json_errc : unsigned char {
+    other,
+    /* malformed json text */
+    unexpected_character,  // that no token starts with
+    unterminated_string,
+    invalid_string,        // a bad escape, a control character or bad UTF-8
+    invalid_number,
+    invalid_literal,       // not quite true, false or null
+    unexpected_token,      // a token out of place, e.g. a missing colon
+    unexpected_end,        // the text ends inside a value
+    trailing_characters,   // more text after a complete value
+    too_deep,              // nesting beyond json::max_depth()
+    /* misuse of values */
+    wrong_type,            // e.g. get_number() of a string, or decode()
+    not_found,             // a missing key
+    out_of_range,          // an index, or an integer too large for decode()
+    /* anything else */
+    invalid_cbor,
+    invalid_pointer,
+    io_error,
+};
+
+/* Thrown by every failing operation. An error found while reading json
+   text also tells where: offset counts bytes from 0, line and column
+   (in bytes) count from 1. All three are 0 when the error has no
+   position, as for the misuse of a value or for CBOR. */
 struct json_exception {
     std::string msg;
+    json_errc code = json_errc::other;
+    std::size_t offset = 0;
+    std::size_t line = 0;
+    std::size_t column = 0;
 };
 
 class json {
@@ -14,24 +54,48 @@ public:
     struct dictionary_iterator;
     struct const_list_iterator;
     struct const_dictionary_iterator;
+    class document;
+    class handler;
+    class push_parser;
+    class ndjson_reader;
+    class lazy;
+    class path;
+    class columns;
+    /* bump allocator backing a document, opaque outside json.cpp */
+    struct arena;
 
     json();
+    /* O(1) for a tree built on the heap: the copies share the lists and
+       dictionaries, each one copied only when one of them changes it.
+       A container once reached through a non-const accessor or iterator
+       may be changed through what they returned, so the later copies
+       copy its elements: read through a json const& what is shared. */
     json(json const&);
-    json(json&&);
+    json(json&&) noexcept;
     ~json();
 
     json& operator=(json const&);
-    json& operator=(json&&);
+    json& operator=(json&&) noexcept;
 
     bool is_list() const;
     bool is_dictionary() const;
     bool is_string() const;
     bool is_number() const;
+    /* a number read or set as an exact 64 bit integer */
+    bool is_integer() const;
     bool is_bool() const;
     bool is_null() const;
 
-    json const& operator[](std::string const&) const;
-    json& operator[](std::string const&);
+    /* the non-const overload adds a missing key with a null value */
+    json const& operator[](std::string_view) const;
+    json& operator[](std::string_view);
+
+    /* O(1) access to the i-th element of a list */
+    json const& operator[](std::size_t) const;
+    json& operator[](std::size_t);
+
+    /* number of elements of a list or dictionary */
+    std::size_t size() const;
 
     list_iterator begin_list();
     const_list_iterator begin_list() const;
@@ -43,33 +107,740 @@ public:
     dictionary_iterator end_dictionary();
     const_dictionary_iterator end_dictionary() const;
 
+    /* The mutable overload turns an integer into a plain double number,
+       the caller being able to write through the reference. The const
+       one returns an integer rounded to the nearest double, by value,
+       and leaves it an exact integer. */
     double& get_number();
-    double const& get_number() const;
+    double get_number() const;
+
+    std::int64_t get_integer() const;
 
     bool& get_bool();
     bool const& get_bool() const;
 
     std::string& get_string();
     std::string const& get_string() const;
+    /* never copies, also for strings borrowed from a document's input */
+    std::string_view get_string_view() const;
 
     void set_string(std::string const&);
     void set_bool(bool);
     void set_number(double);
+    void set_integer(std::int64_t);
     void set_null();
     void set_list();
     void set_dictionary();
     void push_front(json const&);
+    void push_front(json&&);
     void push_back(json const&);
+    void push_back(json&&);
+    /* appends a null element and returns it, to be filled in place */
+    json& emplace_back();
+    /* preallocates room for n elements in a list */
+    void reserve(std::size_t n);
+    /* appends a key to a dictionary, a repeated key overwrites its value */
     void insert(std::pair<std::string, json> const&);
+    void insert(std::pair<std::string, json>&&);
+    /* sets key to null, adding it if missing, and returns its value */
+    json& emplace(std::string key);
+    /* removes key from a dictionary, false if it is missing; the keys
+       after it keep their order, which makes it O(size()) */
+    bool erase(std::string_view key);
+
+    /* Applies an RFC 7386 merge patch in place: a dictionary patch is
+       merged in key by key, recursively, a null value removing its key,
+       any other patch replaces the whole value. The work is in
+       proportion to patch, plus one pass over every dictionary that
+       loses keys. The rvalue overload moves the values out of patch,
+       which must not be a part of *this, instead of copying them. */
+    void merge_patch(json const& patch);
+    void merge_patch(json&& patch);
+    /* The RFC 6902 JSON Patch turning from into to, a list of add,
+       remove and replace operations. Lists are compared index by index,
+       so an element inserted in the middle replaces all the following
+       ones. Containers that from and to share are not looked into, so
+       diffing a copy against its changed original is in proportion to
+       the changes. */
+    static json diff(json const& from, json const& to);
+
+    /* Same value: dictionaries with the same keys in any order, numbers
+       equal as numbers, an integer and a double only when the double is
+       exactly that integer. */
+    bool operator==(json const&) const;
+    bool operator!=(json const&) const;
+
+    /* Writes the value as json text, on one line, or indented by indent
+       spaces per level. Numbers read back exactly; strings are escaped. */
+    std::string dump(unsigned indent = 0) const;
+    void dump(std::ostream& out, unsigned indent = 0) const;
+
+    /* The value as a CBOR data item (RFC 8949): integers take the
+       smallest width that holds them, doubles become float32 when that
+       is exact, containers have definite lengths. */
+    std::string to_cbor() const;
+    /* Decodes exactly one CBOR data item. Text strings, map keys
+       included, must be valid UTF-8; a byte string throws with
+       json_errc::wrong_type. Maps need string keys, tags are dropped
+       and undefined reads as null. */
+    static json from_cbor(std::string_view data);
+    /* reports the content of one CBOR data item to h, see from_cbor() */
+    static void parse_cbor(std::string_view data, handler& h);
+
+    /* Parses exactly one json value out of input. The parsers of trees
+       and events are lenient the way the first versions of this one
+       were, json::lazy is not: a comma may trail or stand alone in a
+       container ([1,] and [,]), a boolean may be a key, and numbers,
+       null or brackets where a key should be, a key without a value
+       ({"a":}) and a colon after a member ({"a":1:}) are skipped.
+       validate() accepts only RFC 8259. */
+    static json parse(std::string_view input);
+    /* Like parse(), but malformed input returns false, leaving out as
+       it was and describing the error in *error if given, instead of
+       throwing. Only out of memory still throws. */
+    static bool try_parse(std::string_view input, json& out, json_exception* error = nullptr);
+    /* parses the file at path, memory mapping it when possible */
+    static json parse_file(std::string const& path);
+    /* Like parse() and parse_file(), but the elements of a large top
+       level list are parsed on threads threads, 0 for one per core. */
+    static json parse_parallel(std::string_view input, unsigned threads = 0);
+    static json parse_file_parallel(std::string const& path, unsigned threads = 0);
+
+    /* what validate() found in a valid value: how many values it holds,
+       containers included, and how deep they nest */
+    struct validation {
+        std::size_t values = 0;
+        std::size_t depth = 0;
+    };
+    /* Checks that input holds exactly one json value as RFC 8259 has
+       it, without the leniency of the parsers, throwing like parse()
+       when it does not, without building anything: it does not
+       allocate. try_validate() returns false instead of throwing. */
+    static validation validate(std::string_view input);
+    static bool try_validate(std::string_view input, validation* out = nullptr, json_exception* error = nullptr);
+
+    /* Containers nested deeper than max_depth() make every parser throw
+       with json_errc::too_deep, bounding the memory spent on an input
+       and the stack of what recurses over a tree, like dump() and the
+       destructor. 1024 by default, shared by all threads. */
+    static void set_max_depth(std::size_t depth);
+    static std::size_t max_depth();
+
+    /* Report the content of one json value out of input, or of every
+       value of the stream one after the other, to h without building
+       a tree: memory does not grow with the size of the input. */
+    static void parse(std::string_view input, handler& h);
+    static void parse(std::istream& input, handler& h);
+
+    /* the members of a struct T that decode() fills, see JSON_FIELDS */
+    template<typename T> struct fields;
+    template<typename T, typename M> struct field;
+    /* how decode() fills a value of one C++ type, a table of functions
+       generated for it in json.hpp */
+    struct binding;
+
+    /* Decode one json value out of input straight into a C++ value,
+       without building a tree: a struct declared with JSON_FIELDS, a
+       bool, a number, a std::string, or a std::optional or std::vector
+       of those. Keys that are no field are skipped, missing ones keep
+       their value; a value of the wrong type, or out of the range of an
+       integer, throws. The value of a key that is no field is jumped
+       over matching only its brackets and quotes, so it is not checked
+       any further. */
+    template<typename T> static T decode(std::string_view input);
+    template<typename T> static void decode(std::string_view input, T& out);
+
+    /* The counters of json::stats summed over every thread since the
+       last reset_stats(), all zero unless json.cpp is built with
+       -DJSON_STATS. Resetting while a parse runs may lose its counts. */
+    struct stats;
+    static stats read_stats();
+    static void reset_stats();
 
 private:
-    struct impl;
-    impl* pimpl;
+    /* type tag of the value currently held */
+    enum class kind : unsigned char {
+        null,
+        number,
+        integer,
+        boolean,
+        string,
+        string_ref,
+        list,
+        dictionary,
+    };
+
+    /* a string pointing into the input pinned by a document */
+    struct string_ref_data {
+        const char* data;
+        std::size_t size;
+        arena* owner;
+        /* filled once by get_string() const, owned by the arena */
+        mutable std::atomic<std::string*> cache;
+    };
+
+    /* out of line storage for the containers, defined in json.cpp */
+    struct list_storage;
+    struct dictionary_storage;
+    /* the parser builds values through it, see json.cpp */
+    friend struct json_builder;
+
+    template<typename V> static constexpr binding make_binding();
+    template<typename V> static binding const& binding_of();
+    /* the compile time perfect hash from key to field of a struct */
+    template<typename T> struct field_index;
+    static constexpr std::uint32_t key_hash(std::string_view key, std::uint32_t seed);
+    static void decode_into(std::string_view input, void* target, binding const& b);
+
+    /* releases the current value and leaves *this as null */
+    void destroy();
+    void copy_from(json const&);
+    void move_from(json&&);
+    /* the storage of the container, copied first if it is shared: every
+       change to the elements goes through one of them */
+    list_storage& own_list();
+    dictionary_storage& own_dictionary();
+
+    kind tag;
+    /* scalars and strings live inline (std::string keeps short strings
+       in its own buffer), only containers need a heap allocation, which
+       copies share */
+    union {
+        double number;
+        std::int64_t integer;
+        bool b;
+        std::string s;
+        string_ref_data ref;
+        list_storage* l;
+        dictionary_storage* dict;
+    };
 };
 
-std::ostream& operator<<(std::ostream& lhs, json const& rhs);
-std::istream& operator>>(std::istream& lhs, json& rhs);
+/* Receives the content of a json text as events in document order.
+   Every key comes right before its value; keys and strings are the
+   text they stand for, escape sequences decoded, and only valid during
+   the call. Unused events can be left alone. */
+class json::handler {
+public:
+    virtual ~handler() = default;
+
+    virtual void on_null() {}
+    virtual void on_boolean(bool) {}
+    virtual void on_number(double) {}
+    /* numbers that are exact 64 bit integers, by default on_number() */
+    virtual void on_integer(std::int64_t value) { this->on_number(static_cast<double>(value)); }
+    virtual void on_string(std::string_view) {}
+    virtual void on_key(std::string_view) {}
+    virtual void on_start_object() {}
+    virtual void on_end_object() {}
+    virtual void on_start_array() {}
+    virtual void on_end_array() {}
+};
+
+/* Parses one json value pushed in chunks of any size as they arrive,
+   e.g. from a socket, keeping the open containers on an explicit stack
+   instead of blocking on a stream. Either builds a tree or reports the
+   events to a handler, strings being only valid during the call. After
+   a json_exception only reset() may be called. */
+class json::push_parser {
+public:
+    enum class status {
+        need_more_data,
+        complete,
+    };
+
+    /* builds a tree, see root() */
+    push_parser();
+    /* reports the value to h instead */
+    explicit push_parser(handler& h);
+    push_parser(push_parser const&) = delete;
+    ~push_parser();
+
+    push_parser& operator=(push_parser const&) = delete;
+
+    /* Consumes the n bytes at data, which may end anywhere inside a
+       token. A number at the very end of the input can only be told
+       complete by finish(). */
+    status feed(const char* data, std::size_t n);
+    /* the input is over: throws if the value is incomplete */
+    void finish();
+    /* forgets the current value, ready for a new one */
+    void reset();
+
+    /* the tree built by push_parser(), once complete */
+    json& root();
+
+private:
+    struct state;
+    state* st;
+};
+
+/* Reads JSON Lines, one json value per line, a batch of lines at a
+   time. The lines of a batch are parsed in parallel by a pool of
+   threads owned by the reader, the records always come out in input
+   order. Blank lines are skipped; a malformed line throws a
+   json_exception naming it and drops the rest of its batch. */
+class json::ndjson_reader {
+public:
+    /* threads == 0 uses one thread per core; a batch holds whole lines
+       for about batch_size bytes of input */
+    explicit ndjson_reader(std::istream& input, unsigned threads = 0, std::size_t batch_size = std::size_t(4) << 20);
+    ndjson_reader(ndjson_reader const&) = delete;
+    ~ndjson_reader();
+
+    ndjson_reader& operator=(ndjson_reader const&) = delete;
+
+    /* replaces batch with the list of the records of the next batch,
+       false once the input is over */
+    bool read(json& batch);
+    /* reports the records of the next batch to h one after the other,
+       false once the input is over: the threads parse every line into
+       its events, the calling thread reports them, no tree built */
+    bool read(handler& h);
+
+private:
+    struct state;
+    state* st;
+};
+
+/* A parsed tree whose containers all live in one arena owned by the
+   document and released in one shot when it is destroyed or reparsed.
+   Values copied out of a document are independent heap copies; values
+   moved out still point into the arena and must not outlive it. */
+class json::document {
+public:
+    document();
+    document(document const&) = delete;
+    document(document&&) noexcept;
+    ~document();
+
+    document& operator=(document const&) = delete;
+    document& operator=(document&&) noexcept;
+
+    /* Parse a new tree, reusing the memory of the previous one. Long
+       strings without a copy of their own point into the input, which
+       the document pins: parse() keeps a copy of input in the arena,
+       parse_file() keeps the file mapped, and parse_borrowed() uses
+       input as it is, so it must outlive the document. */
+    void parse(std::string_view input);
+    void parse_borrowed(std::string_view input);
+    void parse_file(std::string const& path);
+
+    json& root();
+    json const& root() const;
+
+    /* bytes currently reserved by the arena */
+    std::size_t arena_size() const;
+
+private:
+    /* drops the tree, the arena keeps its largest block for reuse */
+    void clear();
+
+    arena* a;
+    json value;
+};
+
+/* A read-only view of a json text that parses on demand. A container
+   only knows where it begins and ends until it is first accessed; then
+   it splits itself into its children, which it keeps, each of them
+   again a view over its own range. Scalars are decoded when read.
+   The text must outlive the view. Syntax errors surface as a
+   json_exception from the access that runs into them. Unlike json,
+   concurrent const access is not safe. */
+class json::lazy {
+public:
+    /* the view of the single json value in input */
+    explicit lazy(std::string_view input);
+    lazy(lazy const&) = delete;
+    lazy(lazy&&) noexcept;
+    ~lazy();
+
+    lazy& operator=(lazy const&) = delete;
+    lazy& operator=(lazy&&) noexcept;
+
+    bool is_list() const;
+    bool is_dictionary() const;
+    bool is_string() const;
+    bool is_number() const;
+    bool is_integer() const;
+    bool is_bool() const;
+    bool is_null() const;
+
+    /* the value of key in a dictionary, throws if it is missing */
+    lazy const& operator[](std::string_view key) const;
+    /* the i-th element of a list, or the i-th value of a dictionary */
+    lazy const& operator[](std::size_t i) const;
+    /* the i-th key of a dictionary, escape sequences left as they are;
+       operator[] compares keys decoded */
+    std::string_view key(std::size_t i) const;
+    /* number of elements of a list or dictionary */
+    std::size_t size() const;
+
+    double get_number() const;
+    std::int64_t get_integer() const;
+    bool get_bool() const;
+    /* the characters between the quotes, escape sequences left as they are */
+    std::string_view get_string_view() const;
+    /* the string they stand for, escape sequences decoded */
+    std::string get_string() const;
+
+    /* the text of the value, as found in the input */
+    std::string_view text() const;
+    /* parses the whole value into a tree */
+    json to_json() const;
+
+private:
+    struct children;
+
+    lazy(const char* begin, const char* end);
+    /* the children, splitting the container the first time */
+    children const& split() const;
+
+    std::string_view range;
+    mutable children* cache;
+};
+
+/* A JSON Pointer (RFC 6901) compiled once to be evaluated many times,
+   e.g. "/users/0/name". Keys are unescaped and hashed up front, so a
+   lookup is a hash probe per step. */
+class json::path {
+public:
+    /* one reference token of the pointer, opaque outside json.cpp */
+    struct step;
+
+    enum class mode : unsigned char {
+        /* every token names a key or an index, as RFC 6901 has it */
+        pointer,
+        /* a "*" token also matches every element of a list or every
+           value of a dictionary, so a "*" key cannot be named */
+        wildcards,
+    };
+
+    /* throws json_exception if pointer is malformed, "" is the root */
+    explicit path(std::string_view pointer, mode m = mode::pointer);
+    path(path const&) = delete;
+    path(path&&) noexcept;
+    ~path();
+
+    path& operator=(path const&) = delete;
+    path& operator=(path&&) noexcept;
+
+    /* the first value matched, nullptr if there is none */
+    json const* find(json const& root) const;
+    json* find(json& root) const;
+    /* a list with a copy of every value matched, in document order */
+    json select(json const& root) const;
+
+    /* Straight out of the json text, building only the values matched:
+       the first overload returns them in a list, the second reports
+       them to h one after the other. */
+    json extract(std::string_view input) const;
+    void extract(std::string_view input, handler& h) const;
+
+private:
+    step* steps;
+    std::size_t count;
+};
+
+/* A list of flat records, e.g. [{"id":1,"name":"a"},{"id":2}], parsed
+   straight into one buffer per key, laid out like the arrays of Apache
+   Arrow, without building a tree: row i of every column comes from the
+   i-th record. The columns are either declared up front, the other keys
+   being skipped over, or found in the records, a key first seen in a
+   later record adding a column null in the rows before it. A key that
+   is missing from a record, or null, is a null in its column. */
+class json::columns {
+public:
+    /* the Arrow type of a column: null (no value seen), bool, int64,
+       float64 and large_utf8 */
+    enum class type : unsigned char {
+        null,
+        boolean,
+        integer,
+        number,
+        string,
+    };
+
+    /* The buffers of one column, of rows() rows each; only the ones of
+       its kind are filled, and a null row holds 0, false or "". */
+    struct column {
+        std::string name;
+        type kind = type::null;
+        std::size_t null_count = 0;
+        /* bit i, the least significant first, is set when row i is not null */
+        std::vector<std::uint8_t> validity;
+        /* boolean: the values, packed as bits like validity */
+        std::vector<std::uint8_t> bits;
+        std::vector<std::int64_t> integers;
+        std::vector<double> numbers;
+        /* string: row i is data[offsets[i], offsets[i + 1]), in UTF-8 */
+        std::vector<std::int64_t> offsets;
+        std::string data;
+    };
+
+    /* finds the columns in the records, the type of each one in its
+       values: integers become numbers once a column holds both */
+    columns();
+    /* Only these columns, in this order. A column declared type::null
+       takes its type from its values as above; the others keep theirs,
+       an integer column taking only numbers that are integers. */
+    explicit columns(std::vector<std::pair<std::string, type>> schema);
 
+    /* Replace the rows with the records of input, or of the file at
+       path. A value that is not a scalar, or whose type does not fit
+       its column, throws json_errc::wrong_type; a repeated key keeps
+       the last value, as in a tree. The buffers keep their memory. */
+    void parse(std::string_view input);
+    void parse_file(std::string const& path);
 
+    std::size_t rows() const;
+    /* number of columns */
+    std::size_t size() const;
+    column const& operator[](std::size_t i) const;
+    /* throws json_errc::not_found if there is no such column */
+    column const& operator[](std::string_view name) const;
 
+private:
+    std::vector<std::pair<std::string, type>> schema;
+    bool detect;
+    std::vector<column> cols;
+    std::size_t count = 0;
+};
+
+/* What the parser and the values did, see json::read_stats() */
+struct json::stats {
+    /* tokens of json text read, by type */
+    struct {
+        std::uint64_t open_brace;
+        std::uint64_t close_brace;
+        std::uint64_t open_bracket;
+        std::uint64_t close_bracket;
+        std::uint64_t colon;
+        std::uint64_t comma;
+        std::uint64_t string;
+        std::uint64_t number;
+        std::uint64_t boolean;
+        std::uint64_t null;
+    } tokens;
+    /* json texts parsed, and their bytes */
+    std::uint64_t documents;
+    std::uint64_t bytes;
+    /* numbers too long or too precise for the fast path of the number
+       parser, left to std::from_chars */
+    std::uint64_t slow_numbers;
+    /* strings with escape sequences, decoded rather than left in place */
+    std::uint64_t escaped_strings;
+    /* Heap allocations made for values, and their bytes: containers,
+       their buffers, arena blocks, and strings too long to be stored
+       inline. Temporary buffers of the parser are not counted. */
+    std::uint64_t allocations;
+    std::uint64_t allocated_bytes;
+    /* calls of the copy and of the move constructor and assignment */
+    std::uint64_t copies;
+    std::uint64_t moves;
+    /* nanoseconds spent building structural indexes, parsing and
+       writing json text; a serial parse includes its index */
+    std::uint64_t index_ns;
+    std::uint64_t parse_ns;
+    std::uint64_t dump_ns;
+};
+
+/* One member of a struct for JSON_FIELDS: the key naming it in the
+   json text and the pointer to it, e.g. json::field("id", &user::id). */
+template<typename T, typename M>
+struct json::field {
+    using member_type = M;
+
+    constexpr field(std::string_view name, M T::*member) : name(name), member(member) {}
+
+    std::string_view name;
+    M T::*member;
+};
+
+/* Declares the fields of the struct T for json::decode(), at global
+   scope and once per struct:
+       JSON_FIELDS(point, json::field("x", &point::x), json::field("y", &point::y));
+   The keys get a perfect hash at compile time, so telling which field
+   a key names is one hash and one compare. */
+#define JSON_FIELDS(T, ...) \
+    template<> struct json::fields<T> { \
+        static constexpr auto table = std::make_tuple(__VA_ARGS__); \
+    }
+
+struct json::binding {
+    /* scalars: store the value, nullptr where the type takes none */
+    void (*on_null)(void* target);
+    void (*on_boolean)(void* target, bool value);
+    void (*on_integer)(void* target, std::int64_t value);
+    void (*on_number)(void* target, double value);
+    void (*on_string)(void* target, std::string_view text);
+    /* std::optional: makes the value present and returns it */
+    void* (*unwrap)(void* target, binding const** inner);
+    /* structs: the member named key, nullptr if no field has that name */
+    void* (*member)(void* target, std::string_view key, binding const** b);
+    /* std::vector: empty it, then append one element per value */
+    void (*clear)(void* target);
+    void* (*element)(void* target, binding const** b);
+};
+
+/* FNV-1a, the seed picked by field_index to avoid collisions */
+constexpr std::uint32_t json::key_hash(std::string_view key, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (char c : key)
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+template<typename T>
+struct json::field_index {
+    using table_type = std::decay_t<decltype(fields<T>::table)>;
+    static constexpr std::size_t count = std::tuple_size_v<table_type>;
+    static_assert(count < 0xffff, "too many fields");
+
+    struct shape {
+        std::uint32_t seed;
+        std::size_t size;  // of the slot table, a power of two, 0 if none
+    };
 
+    template<std::size_t... I>
+    static constexpr std::array<std::string_view, count> names(std::index_sequence<I...>) {
+        return {{std::get<I>(fields<T>::table).name...}};
+    }
+
+    /* the smallest table, and a seed for it, where no two keys collide */
+    static constexpr shape search() {
+        constexpr std::array<std::string_view, count> n = names(std::make_index_sequence<count>{});
+        for (std::size_t i = 0; i < count; ++i)
+            for (std::size_t j = i + 1; j < count; ++j)
+                if (n[i] == n[j])
+                    return {0, 0};
+        std::size_t size = 1;
+        while (size < 2 * count)
+            size *= 2;
+        for (; size <= (std::size_t(1) << 16); size *= 2) {
+            for (std::uint32_t seed = 0; seed < 256; ++seed) {
+                bool collision = false;
+                for (std::size_t i = 0; i < count && !collision; ++i)
+                    for (std::size_t j = i + 1; j < count && !collision; ++j)
+                        collision = ((key_hash(n[i], seed) ^ key_hash(n[j], seed)) & (size - 1)) == 0;
+                if (!collision)
+                    return {seed, size};
+            }
+        }
+        return {0, 0};
+    }
+
+    /* slot -> 1 + index of the field hashing there, 0 for none */
+    template<std::size_t size>
+    static constexpr std::array<std::uint16_t, size> slots(std::uint32_t seed) {
+        constexpr std::array<std::string_view, count> n = names(std::make_index_sequence<count>{});
+        std::array<std::uint16_t, size> s{};
+        for (std::size_t i = 0; i < count; ++i)
+            s[key_hash(n[i], seed) & (size - 1)] = static_cast<std::uint16_t>(i + 1);
+        return s;
+    }
+
+    template<std::size_t I>
+    static void* member_at(void* target, binding const** b) {
+        auto const& f = std::get<I>(fields<T>::table);
+        *b = &binding_of<typename std::decay_t<decltype(f)>::member_type>();
+        return &(static_cast<T*>(target)->*f.member);
+    }
+
+    template<std::size_t... I>
+    static void* open_member(std::size_t slot, void* target, binding const** b, std::index_sequence<I...>) {
+        static constexpr void* (*const open[])(void*, binding const**) = {nullptr, &member_at<I>...};
+        return open[slot](target, b);
+    }
+
+    static void* member(void* target, std::string_view key, binding const** b) {
+        static constexpr shape s = search();
+        static_assert(s.size != 0, "JSON_FIELDS names the same key twice");
+        static constexpr std::array<std::uint16_t, s.size> table = slots<s.size>(s.seed);
+        static constexpr std::array<std::string_view, count> n = names(std::make_index_sequence<count>{});
+        std::uint16_t slot = table[key_hash(key, s.seed) & (s.size - 1)];
+        if (slot == 0 || n[slot - 1] != key)
+            return nullptr;
+        return open_member(slot, target, b, std::make_index_sequence<count>{});
+    }
+};
+
+template<typename V> struct json_is_optional : std::false_type {};
+template<typename V> struct json_is_optional<std::optional<V>> : std::true_type {};
+template<typename V> struct json_is_vector : std::false_type {};
+template<typename V, typename A> struct json_is_vector<std::vector<V, A>> : std::true_type {};
+
+template<typename V>
+constexpr json::binding json::make_binding() {
+    binding b{};
+    if constexpr (std::is_same_v<V, bool>) {
+        b.on_boolean = [](void* t, bool value) { *static_cast<V*>(t) = value; };
+    } else if constexpr (std::is_integral_v<V>) {
+        b.on_integer = [](void* t, std::int64_t value) {
+            bool fits;
+            if constexpr (std::is_signed_v<V>)
+                fits = value >= std::numeric_limits<V>::min() && value <= std::numeric_limits<V>::max();
+            else
+                fits = value >= 0 && static_cast<std::uint64_t>(value) <= std::numeric_limits<V>::max();
+            if (!fits)
+                throw json_exception{"integer out of the range of its field", json_errc::out_of_range};
+            *static_cast<V*>(t) = static_cast<V>(value);
+        };
+        b.on_number = [](void* t, double value) {
+            /* 2^bits for unsigned, 2^(bits-1) for signed, exact as doubles */
+            double limit = 2.0 * static_cast<double>(std::numeric_limits<V>::max() / 2 + 1);
+            if (!(value >= static_cast<double>(std::numeric_limits<V>::min()) && value < limit)
+                    || static_cast<double>(static_cast<V>(value)) != value)
+                throw json_exception{"number that is not an integer in the range of its field", json_errc::out_of_range};
+            *static_cast<V*>(t) = static_cast<V>(value);
+        };
+    } else if constexpr (std::is_floating_point_v<V>) {
+        b.on_integer = [](void* t, std::int64_t value) { *static_cast<V*>(t) = static_cast<V>(value); };
+        b.on_number = [](void* t, double value) { *static_cast<V*>(t) = static_cast<V>(value); };
+    } else if constexpr (std::is_same_v<V, std::string>) {
+        b.on_string = [](void* t, std::string_view text) { static_cast<V*>(t)->assign(text.data(), text.size()); };
+    } else if constexpr (json_is_optional<V>::value) {
+        b.on_null = [](void* t) { static_cast<V*>(t)->reset(); };
+        b.unwrap = [](void* t, binding const** inner) -> void* {
+            V& o = *static_cast<V*>(t);
+            if (!o)
+                o.emplace();
+            *inner = &binding_of<typename V::value_type>();
+            return &*o;
+        };
+    } else if constexpr (json_is_vector<V>::value) {
+        static_assert(!std::is_same_v<typename V::value_type, bool>, "std::vector<bool> has no element to decode into");
+        b.clear = [](void* t) { static_cast<V*>(t)->clear(); };
+        b.element = [](void* t, binding const** e) -> void* {
+            V& v = *static_cast<V*>(t);
+            v.emplace_back();
+            *e = &binding_of<typename V::value_type>();
+            return &v.back();
+        };
+    } else {
+        b.member = &field_index<V>::member;
+    }
+    return b;
+}
+
+template<typename V>
+json::binding const& json::binding_of() {
+    static constexpr binding b = make_binding<V>();
+    return b;
+}
+
+template<typename T>
+void json::decode(std::string_view input, T& out) {
+    decode_into(input, &out, binding_of<T>());
+}
+
+template<typename T>
+T json::decode(std::string_view input) {
+    T out{};
+    decode(input, out);
+    return out;
+}
+
+/* the compact json text of rhs, see json::dump() */
+std::ostream& operator<<(std::ostream& lhs, json const& rhs);
+std::istream& operator>>(std::istream& lhs, json& rhs);
@@ -0,0 +1,1016 @@
+/* Differential and round trip tests of the parser.
+
+   Builds as its own program, json.cpp being compiled along with it:
+
+       g++ -std=c++17 -O2 -pthread -DJSON_NO_MAIN tests/tests.cpp -o json_tests
+
+   and once more with -DJSON_STATS to check the counters of json::stats.
+
+   Every input is parsed by every mode, the tree parser, the document,
+   the push parser fed whole and a byte at a time, the stream parser,
+   the tokenizer driven by the structural index, as the parallel parser
+   runs it on its slices, validate() and, for lists, the parallel parser:
+   they must all agree on the tree, or all fail with the same error.
+   Random trees then go through dump(), CBOR and diff() and must come
+   back equal. ./json_tests prints every failed check and exits with 1
+   if there was one. */
+
+#include "../json.cpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+
+static int failures = 0;
+
+/* operator new counts its calls while counting is on, for the code that
+   must not allocate; the other forms go through this one */
+static std::atomic<bool> counting{false};
+static std::atomic<std::size_t> allocations{0};
+
+void *operator new(std::size_t n) {
+    if (counting)
+        ++allocations;
+    if (void *p = std::malloc(n != 0 ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+/* out of line, as in bench.cpp: inlined into a delete expression, free()
+   looks to GCC like the wrong deallocation of what new returned */
+__attribute__((noinline)) static void counted_free(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    counted_free(p);
+}
+
+/* the number of allocations made by f */
+template<typename F>
+static std::size_t allocations_of(F f) {
+    allocations = 0;
+    counting = true;
+    f();
+    counting = false;
+    return allocations;
+}
+
+static void check(bool ok, std::string const &what) {
+    if (!ok) {
+        ++failures;
+        std::printf("FAIL %s\n", what.c_str());
+    }
+}
+
+/* what parsing a text gave: the tree as json text, or the error */
+struct outcome {
+    bool ok = false;
+    std::string tree;
+    json_errc code = json_errc::other;
+
+    std::string describe() const {
+        return ok ? tree : "error " + std::to_string(static_cast<int>(code));
+    }
+};
+
+template<typename F>
+static outcome attempt(F f) {
+    outcome o;
+    try {
+        o.tree = f().dump();
+        o.ok = true;
+    } catch (json_exception const &e) {
+        o.code = e.code;
+    }
+    return o;
+}
+
+static json push_parse(std::string_view text, std::size_t chunk) {
+    json::push_parser p;
+    for (std::size_t i = 0; i < text.size(); i += chunk)
+        p.feed(text.data() + i, std::min(chunk, text.size() - i));
+    p.finish();
+    return p.root();
+}
+
+static json stream_parse(std::string const &text) {
+    std::istringstream in(text);
+    json j;
+    in >> j;
+    return j;
+}
+
+/* the tree of the tokenizer driven by the structural index */
+static json indexed_parse(std::string_view text) {
+    vector<uint32_t> index = build_structural_index(text);
+    Tokenizer t(text, index);
+    tree_builder b(nullptr, std::string_view());
+    parse_document(t, b);
+    return std::move(b.root());
+}
+
+/* where the document file mode writes the text it parses */
+static const std::string document_file = (std::filesystem::temp_directory_path() / "json_tests_document.json").string();
+
+/* The tree parse gives in a document that has parsed something else
+   before, read in place: long strings point into the input. A copy
+   must not depend on the document, and reads the same. */
+template<typename F>
+static outcome in_document(F parse) {
+    outcome o;
+    json::document d;
+    d.parse("[\"a string long enough to point into the input\",{\"and a key as long as that\":1}]");
+    try {
+        parse(d);
+    } catch (json_exception const &e) {
+        o.code = e.code;
+        return o;
+    }
+    json const &root = d.root();
+    o.tree = root.dump();
+    o.ok = true;
+    json copy(root);
+    check(root == copy && json::from_cbor(root.to_cbor()) == copy, "CBOR of a tree in a document " + o.tree);
+    d = json::document();
+    check(copy.dump() == o.tree, "copy out of a document of " + o.tree);
+    return o;
+}
+
+static void compare(std::string const &name, std::string const &text, outcome const &expected, outcome const &got) {
+    check(expected.ok == got.ok && (expected.ok ? expected.tree == got.tree : expected.code == got.code),
+          name + " of " + text.substr(0, 80) + ": " + got.describe() + " instead of " + expected.describe());
+}
+
+/* every mode agrees with json::parse() on text */
+static void differential(std::string const &text) {
+    outcome expected = attempt([&] { return json::parse(text); });
+    /* the stream parser reads any number of values, one after the other */
+    bool one_value = text.find_first_not_of(" \t\r\n") != std::string::npos
+                     && (expected.ok || expected.code != json_errc::trailing_characters);
+    if (one_value)
+        compare("stream", text, expected, attempt([&] { return stream_parse(text); }));
+    compare("document", text, expected, in_document([&](json::document &d) { d.parse(text); }));
+    compare("document file", text, expected, in_document([&](json::document &d) {
+        std::ofstream(document_file, std::ios::binary) << text;
+        d.parse_file(document_file);
+    }));
+    compare("push", text, expected, attempt([&] { return push_parse(text, text.size() + 1); }));
+    compare("push by byte", text, expected, attempt([&] { return push_parse(text, 1); }));
+    compare("indexed", text, expected, attempt([&] { return indexed_parse(text); }));
+    json_exception e;
+    bool valid = json::try_validate(text, nullptr, &e);
+    check(valid == expected.ok && (valid || e.code == expected.code), "validate of " + text.substr(0, 80));
+}
+
+/* texts the parsers take and validate(), held to RFC 8259, refuses */
+static const char *const lenient[] = {
+    "[1,]", "[,]", "{,}", "{\"a\":1,}", "{\"a\":}", "{\"a\"}", "{\"a\":1:}", "{true:1}",
+    "{null}", "{1}", "{\"a\":1,2}", "{\"a\":1,\"b\"}",
+};
+
+static void lenient_text(std::string const &text) {
+    outcome expected = attempt([&] { return json::parse(text); });
+    check(expected.ok, "parse of lenient " + text);
+    compare("document", text, expected, in_document([&](json::document &d) { d.parse(text); }));
+    compare("document file", text, expected, in_document([&](json::document &d) {
+        std::ofstream(document_file, std::ios::binary) << text;
+        d.parse_file(document_file);
+    }));
+    compare("push", text, expected, attempt([&] { return push_parse(text, 1); }));
+    compare("indexed", text, expected, attempt([&] { return indexed_parse(text); }));
+    json_exception e;
+    check(!json::try_validate(text, nullptr, &e) && e.code == json_errc::unexpected_token, "validate of lenient " + text);
+}
+
+/* texts all the modes must agree on, valid or not */
+static const char *const corpus[] = {
+    "null", "true", "false", "0", "-1", "1.5", "-0.25e-3", "1E400", "123456789012345678901234567890",
+    "9007199254740993", "-9223372036854775808", "-0", "[-0,0,-0.0]", "\"\"", "\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"", "\"\\u00e9\\ud83d\\ude00\"",
+    "\"h\xc3\xa9llo\"", "[]", "{}", "[[[]]]", "[1,2,3]", "{\"a\":1,\"b\":[true,false,null],\"c\":{\"d\":\"e\"}}",
+    " \t\r\n[ 1 , { \"k\" : \"v\" } ] \n", "[1.0,2.50,-3e2]", "{\"\":1}", "{\"\":{\"\":[\"\"]},\"a\":\"\"}",
+    /* strings and keys past the inline capacity of std::string, which a
+       document borrows from its input unless they hold escapes */
+    "\"a plain string longer than sixteen bytes\"", "[\"fifteen bytes!\",\"sixteen bytes!!!\",\"seventeen bytes!!\"]",
+    "{\"a key longer than sixteen bytes\":\"a value longer than sixteen, h\xc3\xa9llo\",\"k\":{\"a key longer than sixteen bytes\":1}}",
+    "[\"a long string and then an escape \\n\",\"\\u00e9 an escape and then a long string\"]",
+    /* malformed */
+    "", "   ", "[", "]", "{", "[1", "[1 2]", "{\"a\" 1}", "{\"a\":1 \"b\":2}", "\"abc", "\"\\x\"", "\"\\u12\"",
+    "\"\\ud800\"", "\"\x01\"", "\"\xc3\"", "\"\xed\xa0\x80\"", "nul", "tru", "fals", "[1]x", "[1]true", "[true false]", "{\"a\":tx}", "[1] [2]", "-", "1.", "1e",
+    "--1", "[+1]", "{\"a\":[1,2}", "[1,2}", "@",
+    /* garbage right after a scalar, which the structural index has no entry for */
+    "[1x]", "[1,2x,3]", "[truex]", "[nullz]", "[falsey]", "nullx", "[1true]", "[nullnull]", "{\"a\":1x}", "[1.5e3q]",
+};
+
+/* A repeated key destroys the dictionary it held, which the next one of
+   the same depth would take its keys from in a document. */
+static const char *const repeated_keys[] = {
+    "{\"a\":{\"x\":1,\"y\":2},\"a\":2,\"b\":{\"x\":3,\"y\":4}}",
+    "[{\"a\":{\"k\":[1]},\"a\":null},{\"a\":{\"k\":[2]}}]",
+    "{\"a\":{\"x\":{\"y\":1}},\"a\":{\"z\":2},\"b\":{\"z\":{\"y\":3}}}",
+};
+
+/* a list of count copies of element, for the parallel parser */
+static std::string repeated(std::string const &element, std::size_t count) {
+    std::string s = "[";
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i)
+            s += ',';
+        s += element;
+    }
+    return s + "]";
+}
+
+static void parallel(std::string const &text) {
+    outcome expected = attempt([&] { return json::parse(text); });
+    /* 1 is the serial fallback, and each change of count rebuilds the pool */
+    for (unsigned threads : {4u, 1u, 2u, 4u})
+        compare("parallel on " + std::to_string(threads) + " threads", text, expected,
+                attempt([&] { return json::parse_parallel(text, threads); }));
+}
+
+/* the keys behind a dictionary_iterator are read only, the values not */
+static_assert(!std::is_assignable<decltype((std::declval<json::dictionary_iterator>()->first)), std::string>::value,
+              "a key changed through an iterator would be lost to the index");
+static_assert(std::is_assignable<decltype((std::declval<json::dictionary_iterator>()->second)), json>::value,
+              "values can be changed through an iterator");
+static_assert(std::is_same<std::iterator_traits<json::dictionary_iterator>::iterator_category, std::input_iterator_tag>::value,
+              "*it is no reference, so the iterator is no forward iterator");
+
+/* changes through a dictionary_iterator leave the keys found */
+static void dictionary_iteration() {
+    json d = json::parse("{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7,\"i\":8,\"j\":9}");
+    std::int64_t n = 0;
+    for (json::dictionary_iterator it = d.begin_dictionary(); it != d.end_dictionary(); ++it) {
+        it->second.set_integer(it->second.get_integer() * 10);
+        auto [key, value] = *it;
+        value.set_integer(value.get_integer() + 1);
+        n += key.size();
+    }
+    bool found = n == 10;
+    for (char c = 'a'; c <= 'j'; ++c)
+        found = found && d[std::string(1, c)].get_integer() == (c - 'a') * 10 + 1;
+    check(found && d.size() == 10, "dictionary changed through an iterator: " + d.dump());
+}
+
+/* v reads as the tree t does, every child accessed through v */
+static bool lazy_matches(json::lazy const &v, json const &t) {
+    if (t.is_dictionary()) {
+        if (!v.is_dictionary() || v.size() != t.size())
+            return false;
+        for (json::const_dictionary_iterator it = t.begin_dictionary(); it != t.end_dictionary(); ++it)
+            if (!lazy_matches(v[it->first], it->second))
+                return false;
+        return true;
+    }
+    if (t.is_list()) {
+        if (!v.is_list() || v.size() != t.size())
+            return false;
+        for (std::size_t i = 0; i < t.size(); ++i)
+            if (!lazy_matches(v[i], t[i]))
+                return false;
+        return true;
+    }
+    if (t.is_string())
+        return v.is_string() && v.get_string() == t.get_string();
+    if (t.is_integer())
+        return v.is_integer() && v.get_integer() == t.get_integer();
+    if (t.is_number())
+        return v.is_number() && !v.is_integer() && v.get_number() == t.get_number();
+    if (t.is_bool())
+        return v.is_bool() && v.get_bool() == t.get_bool();
+    return v.is_null();
+}
+
+/* the json_errc of what f throws, other if it throws nothing */
+template<typename F>
+static json_errc error_of(F f) {
+    try {
+        f();
+    } catch (json_exception const &e) {
+        return e.code;
+    }
+    return json_errc::other;
+}
+
+/* the message of what f throws, empty if it throws nothing */
+template<typename F>
+static std::string message_of(F f) {
+    try {
+        f();
+    } catch (json_exception const &e) {
+        return e.msg;
+    }
+    return std::string();
+}
+
+/* json::lazy reads valid texts as json::parse() does, and reports the
+   errors of the parts of a text when they are accessed */
+static void lazy_views() {
+    std::vector<std::string> texts(std::begin(corpus), std::end(corpus));
+    texts.push_back("{\"a\\\"b\":\"x\\ny\",\"\\u00e9\":[1,\"\\u00e9\\/\"],\"c\":{\"\\\\\":-2.5e1}}");
+    for (std::string const &text : texts) {
+        if (!json::try_validate(text))
+            continue;
+        json tree = json::parse(text);
+        json::lazy view(text);
+        check(lazy_matches(view, tree) && view.to_json() == tree, "lazy view of " + text);
+    }
+
+    json::lazy escaped("{\"a\\\"b\":\"x\\ny\",\"\\u00e9\":1}");
+    check(escaped.key(0) == "a\\\"b" && escaped["a\"b"].get_string() == "x\ny"
+          && escaped["a\"b"].get_string_view() == "x\\ny" && escaped["\xc3\xa9"].get_integer() == 1,
+          "lazy view of escaped keys and strings");
+
+    /* past eight keys they are found through a table, the first of a repeated one */
+    std::string many = "{";
+    for (int i = 0; i < 40; ++i)
+        many += (i % 3 ? "\"k" : "\"\\u006b") + std::to_string(i) + "\":" + std::to_string(i) + ",";
+    many += "\"k7\":-1}";
+    json::lazy keyed(many);
+    bool found = keyed.size() == 41;
+    for (int i = 0; i < 40; ++i)
+        found = found && keyed["k" + std::to_string(i)].get_integer() == i;
+    check(found && keyed.key(0) == "\\u006b0", "lazy view of many keys");
+    check(error_of([&] { keyed["k40"]; }) == json_errc::not_found && error_of([&] { keyed["\\u006b0"]; }) == json_errc::not_found,
+          "lazy access of a key missing from many");
+
+    /* only the broken part throws, when it is reached */
+    json::lazy broken("[1,{\"a\" 2},[3,],tru]");
+    check(broken.size() == 4 && broken[0].get_integer() == 1, "lazy view of a list with broken elements");
+    check(error_of([&] { broken[1]["a"]; }) == json_errc::unexpected_token, "lazy access of a missing colon");
+    check(error_of([&] { broken[2].size(); }) == json_errc::unexpected_token, "lazy access of a trailing comma");
+    check(error_of([&] { broken[3].get_bool(); }) == json_errc::wrong_type, "lazy access of a broken literal");
+    check(error_of([&] { broken[4]; }) == json_errc::out_of_range, "lazy access past the end");
+    check(error_of([&] { broken[0]["a"]; }) == json_errc::wrong_type, "lazy access of a key in a number");
+    check(error_of([&] { json::lazy("{\"a\":1}")["b"]; }) == json_errc::not_found, "lazy access of a missing key");
+    json const tree = json::parse("{\"a\":1}");
+    check(message_of([&] { tree["b"]; }) == message_of([&] { json::lazy("{\"a\":1}")["b"]; }), "message of a missing key");
+    check(error_of([&] { json::lazy("[1] 2"); }) == json_errc::trailing_characters, "lazy view of two values");
+    /* the errors of a container are the ones of validate(); a scalar is
+       skipped up to a comma or a bracket, so 1:2 is read as one */
+    for (const char *text : {"[1 2]", "[1,]", "[,1]", "[1,,2]", "[\"a\":2]", "[1}", "{\"a\" 1}", "{\"a\":1,}",
+                             "{,\"a\":1}", "{1:2}", "{true:2}", "{\"a\":}", "{\"a\":\"b\":}", "{\"a\"}"}) {
+        std::string lazy_error = message_of([&] { json::lazy(text).size(); });
+        check(!lazy_error.empty() && lazy_error == message_of([&] { json::validate(text); }),
+              "lazy error of " + std::string(text) + ": " + lazy_error);
+    }
+}
+
+/* CBOR strings become json strings only when they are UTF-8 text */
+static void cbor_strings() {
+    using namespace std::string_literals;
+    check(json::from_cbor("\x62\xc3\xa9"s).get_string() == "\xc3\xa9", "CBOR text string");
+    check(json::from_cbor("\x7f\x61\x61\x62\xc3\xa9\xff"s).get_string() == "a\xc3\xa9", "CBOR indefinite length text string");
+    check(json::from_cbor("\xa1\x7f\x61\x6b\xff\x01"s)["k"].get_integer() == 1, "CBOR indefinite length key");
+    check(error_of([] { json::from_cbor("\x62\xff\xfe"s); }) == json_errc::invalid_cbor, "CBOR text string of bad UTF-8");
+    check(error_of([] { json::from_cbor("\x7f\x61\xc3\x61\xa9\xff"s); }) == json_errc::invalid_cbor,
+          "CBOR text string of chunks that are not UTF-8 one by one");
+    check(error_of([] { json::from_cbor("\xa1\x61\xff\x01"s); }) == json_errc::invalid_cbor, "CBOR key of bad UTF-8");
+    check(error_of([] { json::from_cbor("\x42\x61\x62"s); }) == json_errc::wrong_type, "CBOR byte string");
+    check(error_of([] { json::from_cbor("\x5f\x41\x61\xff"s); }) == json_errc::wrong_type, "CBOR indefinite length byte string");
+    check(error_of([] { json::from_cbor("\xa1\x41\x61\x01"s); }) == json_errc::wrong_type, "CBOR byte string key");
+}
+
+/* "*" is a key like any other unless wildcards are asked for */
+static void path_wildcards() {
+    std::string text = "{\"x\":2,\"*\":1,\"y\":[3,4]}";
+    json tree = json::parse(text);
+    json::path literal("/*");
+    json const *found = literal.find(tree);
+    check(found != nullptr && found->get_integer() == 1, "path to a \"*\" key");
+    check(literal.select(tree).dump() == "[1]" && literal.extract(text).dump() == "[1]", "select of a \"*\" key");
+    check(json::path("/y/*").find(tree) == nullptr, "path of \"*\" in a list");
+    json::path every("/*", json::path::mode::wildcards);
+    check(every.select(tree).dump() == "[2,1,[3,4]]" && every.extract(text).dump() == "[2,1,[3,4]]", "path with a wildcard");
+    check(json::path("/y/*", json::path::mode::wildcards).select(tree).dump() == "[3,4]", "path with a wildcard in a list");
+}
+
+struct point {
+    int x = 0;
+    double y = 0;
+};
+
+struct record {
+    std::int64_t id = 0;
+    std::string name;
+    std::optional<std::string> note;
+    std::vector<point> points;
+    std::vector<std::optional<int>> marks;
+    bool flag = false;
+    std::uint8_t small = 0;
+};
+
+JSON_FIELDS(point, json::field("x", &point::x), json::field("y", &point::y));
+JSON_FIELDS(record, json::field("id", &record::id), json::field("name", &record::name), json::field("note", &record::note),
+            json::field("points", &record::points), json::field("marks", &record::marks), json::field("flag", &record::flag),
+            json::field("small", &record::small));
+
+/* json::decode() fills the fields it knows, skips the other keys and
+   throws on values its fields cannot hold */
+static void decoding() {
+    record r = json::decode<record>(
+        "{\"id\":-9223372036854775808,\"extra\":{\"x\":[1,{\"y\":\"]}\"}]},\"name\":\"a\\nb\",\"note\":\"n\","
+        "\"points\":[{\"x\":1,\"y\":2.5},{\"y\":-1,\"z\":[]},{\"x\":2.0,\"y\":3}],\"marks\":[1,null,-3],"
+        "\"flag\":true,\"small\":255}");
+    check(r.id == std::numeric_limits<std::int64_t>::min() && r.name == "a\nb" && r.note == std::string("n")
+          && r.points.size() == 3 && r.points[0].x == 1 && r.points[0].y == 2.5 && r.points[1].x == 0
+          && r.points[1].y == -1 && r.points[2].x == 2 && r.points[2].y == 3 && r.marks.size() == 3
+          && r.marks[0] == 1 && !r.marks[1] && r.marks[2] == -3 && r.flag && r.small == 255, "decode of a record");
+
+    /* missing keys keep their value, null empties an optional */
+    json::decode("{\"note\":null,\"points\":[]}", r);
+    check(r.id == std::numeric_limits<std::int64_t>::min() && r.name == "a\nb" && !r.note && r.points.empty()
+          && r.marks.size() == 3, "decode into a record already filled");
+
+    /* keys that are no field, many of them hashing to the slot of one */
+    std::string unknown = "{";
+    for (int i = 0; i < 300; ++i)
+        unknown += "\"k" + std::to_string(i) + "\":" + std::to_string(i) + ",";
+    unknown += "\"\":1,\"i\":2,\"ID\":3,\"nam\":4,\"names\":5,\"id \":6,\"x\":7,\"id\":42}";
+    record u = json::decode<record>(unknown);
+    check(u.id == 42 && u.name.empty() && !u.note && u.points.empty() && !u.flag && u.small == 0, "decode skipping unknown keys");
+
+    std::vector<double> numbers = json::decode<std::vector<double>>("[1,2.5,-3e2]");
+    check(numbers == std::vector<double>{1, 2.5, -300}, "decode of a vector of numbers");
+    check(json::decode<std::optional<int>>("null") == std::nullopt && json::decode<std::optional<int>>("7") == 7,
+          "decode of an optional");
+
+    static const std::pair<const char *, json_errc> errors[] = {
+        {"{\"id\":9223372036854775808}", json_errc::out_of_range},
+        /* the first double below -2^63, closer ones round to -2^63 */
+        {"{\"id\":-9223372036854777856}", json_errc::out_of_range},
+        {"{\"id\":1e19}", json_errc::out_of_range},
+        {"{\"id\":1.5}", json_errc::out_of_range},
+        {"{\"small\":256}", json_errc::out_of_range},
+        {"{\"small\":-1}", json_errc::out_of_range},
+        {"{\"points\":[{\"x\":2147483648}]}", json_errc::out_of_range},
+        {"{\"points\":[{\"x\":0.5}]}", json_errc::out_of_range},
+        {"{\"name\":1}", json_errc::wrong_type},
+        {"{\"name\":null}", json_errc::wrong_type},
+        {"{\"flag\":0}", json_errc::wrong_type},
+        {"{\"points\":{}}", json_errc::wrong_type},
+        {"{\"points\":[1]}", json_errc::wrong_type},
+        {"[]", json_errc::wrong_type},
+        {"{\"id\":1", json_errc::unexpected_end},
+    };
+    for (auto const &e : errors)
+        check(error_of([&] { json::decode<record>(e.first); }) == e.second, std::string("decode of ") + e.first);
+}
+
+/* json::stats counts what a parse did, summed over the threads, and
+   stays zero unless json.cpp is built with -DJSON_STATS */
+static void statistics() {
+    std::string text = "{\"a\":[1,2.5,true,null,\"s\\n\"],\"b\":{\"c\":\"" + std::string(40, 'x') + "\"}}";
+    json::reset_stats();
+    json tree = json::parse(text);
+    json::stats s = json::read_stats();
+#if defined(JSON_STATS)
+    check(s.tokens.open_brace == 2 && s.tokens.close_brace == 2 && s.tokens.open_bracket == 1 && s.tokens.close_bracket == 1
+          && s.tokens.colon == 3 && s.tokens.comma == 5 && s.tokens.string == 5 && s.tokens.number == 2
+          && s.tokens.boolean == 1 && s.tokens.null == 1, "tokens counted");
+    check(s.documents == 1 && s.bytes == text.size() && s.slow_numbers == 0 && s.escaped_strings == 1, "documents counted");
+    check(s.allocations >= 4 && s.allocated_bytes >= 40 && s.copies == 0, "allocations of a parse counted");
+
+    json::reset_stats();
+    json::parse("[0.12345678901234567890123,1]");
+    check(json::read_stats().slow_numbers == 1, "slow numbers counted");
+
+    /* a copy shares the containers until one of them changes */
+    json::reset_stats();
+    json copy = tree;
+    json moved = std::move(copy);
+    s = json::read_stats();
+    check(s.copies == 1 && s.moves == 1 && s.allocations == 0, "copies counted: " + std::to_string(s.allocations));
+    moved["z"];
+    check(json::read_stats().allocations > 0, "allocations of a change to a shared tree counted");
+
+    /* the counts of a thread outlive it */
+    json::reset_stats();
+    std::thread other([] { json::parse("[1,2]"); });
+    other.join();
+    json::parse("[3]");
+    s = json::read_stats();
+    check(s.documents == 2 && s.tokens.number == 3 && s.tokens.open_bracket == 2, "counts of two threads summed");
+#else
+    check(s.documents == 0 && s.bytes == 0 && s.tokens.string == 0 && s.allocations == 0 && s.parse_ns == 0,
+          "counters without JSON_STATS");
+#endif
+}
+
+/* an integer equals a double only when the double is exactly that
+   integer, so diff() sees the difference between the two */
+static void mixed_numbers() {
+    auto equal = [](const char *a, const char *b) { return json::parse(a) == json::parse(b); };
+    check(equal("1", "1.0") && equal("-3", "-3e0") && equal("0", "-0.0"), "integers equal to doubles");
+    check(equal("-9223372036854775808", "-9223372036854775808.0"), "the smallest integer equal to a double");
+    check(!equal("9007199254740993", "9007199254740992.0") && !equal("9007199254740992.0", "9007199254740993"),
+          "2^53 + 1 equal to 2^53 as a double");
+    check(!equal("9223372036854775807", "9223372036854775808.0"), "the largest integer equal to 2^63");
+    check(!equal("1", "1.5") && !equal("1", "1e300"), "integers equal to other doubles");
+
+    json patch = json::diff(json::parse("{\"v\":9007199254740993}"), json::parse("{\"v\":9007199254740992.0}"));
+    check(patch.dump() == "[{\"op\":\"replace\",\"path\":\"/v\",\"value\":9007199254740992.0}]",
+          "diff of 2^53 + 1 and 2^53: " + patch.dump());
+    check(json::diff(json::parse("{\"v\":2}"), json::parse("{\"v\":2.0}")).size() == 0, "diff of an integer and its double");
+}
+
+/* the examples of RFC 7386, Appendix A: target, patch, result */
+static const char *const merge_patches[][3] = {
+    {"{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+    {"{\"a\":\"b\"}", "{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}"},
+    {"{\"a\":\"b\"}", "{\"a\":null}", "{}"},
+    {"{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}", "{\"b\":\"c\"}"},
+    {"{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+    {"{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":[\"b\"]}"},
+    {"{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}", "{\"a\":{\"b\":\"d\"}}"},
+    {"{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}", "{\"a\":[1]}"},
+    {"[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]"},
+    {"{\"a\":\"b\"}", "[\"c\"]", "[\"c\"]"},
+    {"{\"a\":\"foo\"}", "null", "null"},
+    {"{\"a\":\"foo\"}", "\"bar\"", "\"bar\""},
+    {"{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}"},
+    {"[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}"},
+    {"{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}"},
+};
+
+static void merging() {
+    for (auto const &m : merge_patches) {
+        json expected = json::parse(m[2]);
+        json target = json::parse(m[0]);
+        json const patch = json::parse(m[1]);
+        target.merge_patch(patch);
+        check(target == expected && patch == json::parse(m[1]), std::string("merge patch ") + m[1] + " into " + m[0] + ": " + target.dump());
+        json moved = json::parse(m[0]);
+        moved.merge_patch(json::parse(m[1]));
+        check(moved == expected, std::string("merge of a moved patch ") + m[1] + " into " + m[0] + ": " + moved.dump());
+    }
+
+    /* past the size where dictionaries are indexed, a shared copy left alone */
+    json original;
+    original.set_dictionary();
+    for (int i = 0; i < 20; ++i)
+        original.emplace("k" + std::to_string(i)).set_integer(i);
+    json changed = original;
+    changed.merge_patch(json::parse("{\"k3\":null,\"k7\":{\"x\":null,\"y\":1},\"k19\":null,\"new\":true}"));
+    check(changed.size() == 19 && changed["k7"].dump() == "{\"y\":1}" && changed["new"].get_bool()
+          && changed["k18"].get_integer() == 18 && original.size() == 20 && original["k3"].get_integer() == 3,
+          "merge patch into a large shared dictionary: " + changed.dump());
+
+    /* a patch that is a part of the target */
+    json nested = json::parse("{\"a\":{\"b\":1,\"a\":{\"c\":2}},\"b\":0}");
+    nested.merge_patch(nested["a"]);
+    check(nested == json::parse("{\"a\":{\"b\":1,\"a\":{\"c\":2},\"c\":2},\"b\":1}"), "merge patch out of the target itself: " + nested.dump());
+}
+
+/* is row i of the column not null? */
+static bool valid_row(json::columns::column const &c, std::size_t i) {
+    return (c.validity[i / 8] >> (i % 8)) & 1;
+}
+
+/* json::columns, finding its columns in the records or told them */
+static void columnar() {
+    using type = json::columns::type;
+    json::columns found;
+    found.parse("[{\"id\":1,\"name\":\"a\"},{\"id\":2.5,\"ok\":true},{\"name\":null,\"id\":3,\"late\":\"z\"}]");
+    check(found.rows() == 3 && found.size() == 4 && found[0].name == "id" && found[1].name == "name"
+          && found[2].name == "ok" && found[3].name == "late", "columns found in the records");
+    json::columns::column const &id = found["id"];
+    check(id.kind == type::number && id.null_count == 0 && id.numbers == std::vector<double>{1, 2.5, 3} && id.integers.empty(),
+          "integers widened to float64 once a column holds a double");
+    json::columns::column const &name = found["name"];
+    check(name.kind == type::string && name.null_count == 2 && valid_row(name, 0) && !valid_row(name, 1) && !valid_row(name, 2)
+          && name.offsets == std::vector<std::int64_t>{0, 1, 1, 1} && name.data == "a", "string column with null rows");
+    json::columns::column const &late = found["late"];
+    check(late.kind == type::string && late.null_count == 2 && !valid_row(late, 0) && !valid_row(late, 1) && valid_row(late, 2)
+          && late.offsets == std::vector<std::int64_t>{0, 0, 0, 1} && late.data == "z", "late key back-filled with nulls");
+    json::columns::column const &ok = found["ok"];
+    check(ok.kind == type::boolean && ok.null_count == 2 && valid_row(ok, 1) && (ok.bits[0] >> 1 & 1), "boolean column");
+
+    found.parse("[{\"n\":1},{\"n\":-2}]");
+    check(found.rows() == 2 && found.size() == 1 && found["n"].kind == type::integer
+          && found["n"].integers == std::vector<std::int64_t>{1, -2}, "integer column, the buffers reused");
+
+    json::columns declared({{"id", type::integer}, {"x", type::null}, {"s", type::string}});
+    declared.parse("[{\"id\":1,\"skip\":{\"a\":[1,{}]},\"x\":1},{\"x\":2.5,\"id\":-4,\"s\":\"h\",\"t\":[]}]");
+    check(declared.rows() == 2 && declared.size() == 3 && declared[0].name == "id" && declared[2].name == "s",
+          "declared columns only, in order");
+    check(declared["id"].kind == type::integer && declared["id"].integers == std::vector<std::int64_t>{1, -4},
+          "declared integer column");
+    check(declared["x"].kind == type::number && declared["x"].numbers == std::vector<double>{1, 2.5},
+          "declared column of no type widened");
+    check(declared["s"].null_count == 1 && !valid_row(declared["s"], 0) && declared["s"].data == "h", "declared string column");
+
+    check(error_of([&] { declared.parse("[{\"id\":1.5}]"); }) == json_errc::wrong_type, "double in an integer column");
+    check(error_of([&] { declared.parse("[{\"s\":1}]"); }) == json_errc::wrong_type, "number in a string column");
+    check(error_of([&] { found.parse("[{\"s\":[1]}]"); }) == json_errc::wrong_type, "list in a column");
+    check(error_of([&] { found.parse("[{\"s\":1},{\"s\":\"a\"}]"); }) == json_errc::wrong_type, "column of numbers and strings");
+    check(error_of([&] { found["nope"]; }) == json_errc::not_found, "missing column");
+    found.parse("[]");
+    check(found.rows() == 0 && found.size() == 0, "columns of no record");
+}
+
+/* Long strings of a document point into its input, until changed
+   through get_string() or copied out. */
+static void borrowed_strings() {
+    std::string text = "[\"a plain string longer than sixteen bytes\",\"short\",{\"a key longer than sixteen bytes\":"
+                       "\"another string longer than sixteen bytes\"}]";
+    auto inside = [&text](std::string_view s) {
+        return s.data() >= text.data() && s.data() + s.size() <= text.data() + text.size();
+    };
+    json copy;
+    {
+        json::document d;
+        d.parse_borrowed(text);
+        json &root = d.root();
+        json const &read = root;
+        check(inside(read[0].get_string_view()) && !inside(read[1].get_string_view())
+              && inside(read[2]["a key longer than sixteen bytes"].get_string_view()), "long strings of a document borrowed");
+        check(read[0].get_string() == "a plain string longer than sixteen bytes" && inside(read[0].get_string_view()),
+              "get_string() const of a borrowed string");
+        copy = root;
+
+        json::reset_stats();
+        root[0].get_string() += "!";
+#if defined(JSON_STATS)
+        check(json::read_stats().allocations == 1, "allocation of a borrowed string made its own counted");
+#endif
+        check(!inside(read[0].get_string_view()) && read[0].get_string() == "a plain string longer than sixteen bytes!"
+              && text.find("bytes!") == std::string::npos, "get_string() of a borrowed string");
+
+        /* a parse again reuses the arena */
+        std::size_t size = d.arena_size();
+        std::string again = text;
+        d.parse_borrowed(again);
+        check(d.arena_size() == size && d.root()[std::size_t(0)].get_string_view().data() == again.data() + 2,
+              "reparse of a document");
+    }
+    text.assign(text.size(), 'x');
+    check(copy.dump() == "[\"a plain string longer than sixteen bytes\",\"short\",{\"a key longer than sixteen bytes\":"
+                         "\"another string longer than sixteen bytes\"}]", "copy out of a destroyed document: " + copy.dump());
+}
+
+/* writes down the events it gets, one per line */
+class event_log : public json::handler {
+public:
+    void on_null() override { this->text += "null\n"; }
+    void on_boolean(bool b) override { this->text += b ? "true\n" : "false\n"; }
+    void on_number(double x) override { this->text += "number " + std::to_string(x) + "\n"; }
+    void on_integer(std::int64_t x) override { this->text += "integer " + std::to_string(x) + "\n"; }
+    void on_string(std::string_view s) override { this->text += "string " + std::string(s) + "\n"; }
+    void on_key(std::string_view s) override { this->text += "key " + std::string(s) + "\n"; }
+    void on_start_object() override { this->text += "{\n"; }
+    void on_end_object() override { this->text += "}\n"; }
+    void on_start_array() override { this->text += "[\n"; }
+    void on_end_array() override { this->text += "]\n"; }
+
+    std::string text;
+};
+
+/* json::path finds in a tree, and extracts from text, what RFC 6901 says */
+/* validate() takes no memory, escape sequences and long strings included */
+static void quiet_validation() {
+    std::vector<std::string> texts(std::begin(corpus), std::end(corpus));
+    texts.push_back("{\"key with escape \\n and more than sixteen\":\"value\\u00e9 long enough to leave any"
+                    " small string buffer xxxxxxxxx\",\"a\":[1,2,3]}");
+    texts.push_back("[\"\\ud83d\\ude00 \\\" \\\\ \\/ \\b\\f\\r\\t \xc3\xa9\",true,false,null,-1.5e300]");
+    for (std::string const &text : texts) {
+        if (!json::try_validate(text))
+            continue;
+        std::size_t n = allocations_of([&] { json::validate(text); });
+        check(n == 0, "validate of " + text + " allocates " + std::to_string(n) + " times");
+    }
+}
+
+static void paths() {
+    std::string text = "{\"a/b\":{\"m~n\":[10,{\"c\":\"d\"},30]},\"\":{\"\":5},\"list\":[0,1,2],"
+                       "\"users\":[{\"name\":\"x\"},{\"name\":\"y\"}]}";
+    json tree = json::parse(text);
+    /* the pointer and what it matches, as json text, "" for nothing */
+    static const char *const cases[][2] = {
+        {"", nullptr}, {"/a~1b/m~0n/1/c", "\"d\""}, {"/a~1b/m~0n", "[10,{\"c\":\"d\"},30]"}, {"//", "5"},
+        {"/users/1/name", "\"y\""}, {"/list/0", "0"}, {"/list/2", "2"}, {"/list/3", ""}, {"/list/01", ""},
+        {"/list/-", ""}, {"/list/-1", ""}, {"/list/18446744073709551616", ""}, {"/list/a", ""}, {"/list/0/x", ""},
+        {"/a~1b/m~0n/1/c/d", ""}, {"/a/b", ""}, {"/m~0n", ""}, {"/missing", ""},
+    };
+    for (auto const &c : cases) {
+        std::string expected = c[1] == nullptr ? text : c[1];
+        json::path p(c[0]);
+        json const *found = p.find(static_cast<json const &>(tree));
+        std::string got = found != nullptr ? found->dump() : "";
+        check(got == (expected.empty() ? "" : json::parse(expected).dump()), std::string("find of ") + c[0] + ": " + got);
+        std::string all = expected.empty() ? "[]" : "[" + json::parse(expected).dump() + "]";
+        check(p.select(tree).dump() == all, std::string("select of ") + c[0]);
+        check(p.extract(text).dump() == all, std::string("extract of ") + c[0]);
+        event_log got_events, expected_events;
+        p.extract(text, got_events);
+        if (!expected.empty())
+            json::parse(expected, expected_events);
+        check(got_events.text == expected_events.text, std::string("events extracted by ") + c[0]);
+    }
+
+    /* the keys of a large dictionary are found through its hash index */
+    json large;
+    large.set_dictionary();
+    for (int i = 0; i < 40; ++i)
+        large.emplace("k" + std::to_string(i)).set_integer(i);
+    json const *k17 = json::path("/k17").find(static_cast<json const &>(large));
+    check(k17 != nullptr && k17->get_integer() == 17, "path into a large dictionary");
+
+    json *first = json::path("/list/0").find(tree);
+    if (first != nullptr)
+        first->set_integer(7);
+    check(tree["list"][std::size_t(0)].get_integer() == 7, "change through a path");
+
+    for (const char *malformed : {"a", "a/b", "/m~n", "/a~", "/a~2", "/~x/b", "/a/~"})
+        check(error_of([&] { json::path p(malformed); }) == json_errc::invalid_pointer, std::string("malformed pointer ") + malformed);
+}
+
+/* ndjson_reader reports the events of every line, in order */
+static void ndjson_events() {
+    std::string input;
+    event_log expected;
+    for (int i = 0; i < 500; ++i) {
+        std::string line = "{\"id\":" + std::to_string(i) + ",\"tags\":[\"a\\nb\",-0,1.5,true,null],\"\":{}}";
+        input += line + (i % 7 ? "\n" : "\n\n");
+        json::parse(line, expected);
+    }
+    std::istringstream in(input);
+    json::ndjson_reader reader(in, 4, 1000);
+    event_log got;
+    while (reader.read(got)) {
+    }
+    check(got.text == expected.text, "events of ndjson_reader");
+}
+
+/* a deterministic stream of pseudo random numbers */
+class generator {
+public:
+    std::uint64_t next() {
+        this->state = this->state * 6364136223846793005u + 1442695040888963407u;
+        return this->state >> 33;
+    }
+
+    json value(int depth) {
+        json j;
+        switch (this->next() % (depth > 4 ? 5 : 7)) {
+            case 0:
+                break;
+            case 1:
+                j.set_bool(this->next() % 2);
+                break;
+            case 2:
+                j.set_integer(static_cast<std::int64_t>(this->next() << 31 | this->next()) - (std::int64_t(1) << 61));
+                break;
+            case 3:
+                j.set_number(static_cast<double>(this->next()) / 1024.0 - 1e6);
+                break;
+            case 4: {
+                static const char *const strings[] = {"", "plain", "quote \" backslash \\", "tab\tnewline\n",
+                                                      "h\xc3\xa9llo \xf0\x9f\x98\x80", "a/b~c", "\x01\x1f",
+                                                      "a plain string longer than sixteen bytes",
+                                                      "h\xc3\xa9llo, a long string of UTF-8 \xf0\x9f\x98\x80"};
+                j.set_string(strings[this->next() % 9]);
+                break;
+            }
+            case 5:
+                j.set_list();
+                for (int n = this->next() % 6; n--;)
+                    j.push_back(this->value(depth + 1));
+                break;
+            default:
+                j.set_dictionary();
+                for (int n = this->next() % 12; n--;)
+                    j.emplace(this->key()) = this->value(depth + 1);
+                break;
+        }
+        return j;
+    }
+
+    /* a copy of j with some values changed, added or removed */
+    json mutate(json const &j, int depth) {
+        if (this->next() % 8 == 0)
+            return this->value(depth);
+        json m;
+        if (j.is_dictionary()) {
+            m.set_dictionary();
+            for (json::const_dictionary_iterator it = j.begin_dictionary(); it != j.end_dictionary(); ++it)
+                if (this->next() % 6)
+                    m.emplace(it->first) = this->next() % 3 ? it->second : this->mutate(it->second, depth + 1);
+            for (int n = this->next() % 3; n--;)
+                m.emplace(this->key()) = this->value(depth + 1);
+        } else if (j.is_list()) {
+            m.set_list();
+            for (json::const_list_iterator it = j.begin_list(); it != j.end_list(); ++it)
+                if (this->next() % 5)
+                    m.push_back(this->next() % 3 ? *it : this->mutate(*it, depth + 1));
+            for (int n = this->next() % 3; n--;)
+                m.push_back(this->value(depth + 1));
+        } else {
+            m = j;
+        }
+        return m;
+    }
+
+private:
+    /* one of a few short keys, the empty one included, or a long one */
+    std::string key() {
+        std::uint64_t k = this->next() % 18;
+        if (k == 17)
+            return "a key longer than sixteen bytes";
+        return k == 16 ? std::string() : std::string(1, static_cast<char>('a' + k));
+    }
+
+    std::uint64_t state = 7;
+};
+
+/* the value at a JSON Pointer, the parent of the last step in *parent */
+static json &parent_of(json &root, std::string const &pointer, std::string &last) {
+    std::vector<std::string> steps;
+    for (std::size_t i = 1; i <= pointer.size();) {
+        std::size_t j = std::min(pointer.find('/', i), pointer.size());
+        std::string step;
+        for (std::size_t k = i; k < j; ++k) {
+            if (pointer[k] == '~')
+                step += pointer[++k] == '0' ? '~' : '/';
+            else
+                step += pointer[k];
+        }
+        steps.push_back(step);
+        i = j + 1;
+    }
+    json *at = &root;
+    for (std::size_t k = 0; k + 1 < steps.size(); ++k)
+        at = at->is_list() ? &(*at)[static_cast<std::size_t>(std::stoul(steps[k]))] : &(*at)[steps[k]];
+    last = steps.back();
+    return *at;
+}
+
+/* applies the add, remove and replace operations of a JSON Patch */
+static void apply(json &root, json const &patch) {
+    for (json::const_list_iterator op = patch.begin_list(); op != patch.end_list(); ++op) {
+        std::string kind = (*op)["op"].get_string();
+        std::string pointer = (*op)["path"].get_string();
+        if (pointer.empty()) {
+            root = (*op)["value"];
+            continue;
+        }
+        std::string last;
+        json &parent = parent_of(root, pointer, last);
+        if (parent.is_dictionary()) {
+            if (kind == "remove")
+                check(parent.erase(last), "remove of a missing key " + pointer);
+            else
+                parent[last] = (*op)["value"];
+        } else {
+            std::size_t i = std::stoul(last);
+            if (kind == "replace") {
+                parent[i] = (*op)["value"];
+            } else if (kind == "add") {
+                check(i == parent.size(), "add in the middle of a list " + pointer);
+                parent.push_back((*op)["value"]);
+            } else {
+                check(i + 1 == parent.size(), "remove in the middle of a list " + pointer);
+                json rest;
+                rest.set_list();
+                for (std::size_t k = 0; k < i; ++k)
+                    rest.push_back(parent[k]);
+                parent = rest;
+            }
+        }
+    }
+}
+
+static void round_trips(generator &g) {
+    for (int i = 0; i < 2000; ++i) {
+        json j = g.value(0);
+        std::string text = j.dump();
+        check(json::parse(text) == j, "dump of " + text);
+        check(json::parse(j.dump(2)) == j, "indented dump of " + text);
+        check(json::from_cbor(j.to_cbor()) == j, "CBOR of " + text);
+        differential(text);
+
+        json changed = g.mutate(j, 0);
+        json patch = json::diff(j, changed);
+        json patched = j;
+        apply(patched, patch);
+        check(patched == changed, "diff " + patch.dump() + " of " + text + " to " + changed.dump());
+        check((patch.size() == 0) == (j == changed), "empty diff of " + text);
+    }
+}
+
+int main() {
+    for (const char *text : corpus)
+        differential(text);
+    for (const char *text : lenient)
+        lenient_text(text);
+    for (const char *text : repeated_keys)
+        differential(text);
+
+    for (const char *element : {"1", "{\"id\":7,\"tags\":[\"a\",\"b\"]}", "[[1],[2,[3]]]", "\"s\""})
+        parallel(repeated(element, 2000));
+    std::string broken = repeated("{\"id\":7}", 2000);
+    broken[broken.size() / 2] = '?';
+    parallel(broken);
+    std::string list = repeated("{\"id\":7}", 2000);
+    parallel(list.substr(0, list.size() - 1) + ",]");
+    parallel("[," + list.substr(1));
+    parallel(list.substr(0, list.size() / 2) + ",," + list.substr(list.size() / 2 + 1));
+    parallel(repeated("1 2", 2000));
+    for (std::string text : {repeated("1 2", 2000), repeated("1:2", 2000), broken}) {
+        std::string serial = message_of([&] { json::parse(text); });
+        std::string threaded = message_of([&] { json::parse_parallel(text, 4); });
+        check(threaded.size() > serial.size() && threaded.compare(threaded.size() - serial.size(), serial.size(), serial) == 0,
+              "message of the parallel parser: " + threaded + " for " + serial);
+    }
+    parallel(repeated("1:2", 2000));
+    /* the elements are one container deeper than themselves */
+    std::size_t depth = json::max_depth();
+    json::set_max_depth(3);
+    parallel(repeated("[[1]]", 2000));
+    parallel(repeated("[[[1]]]", 2000));
+    json::set_max_depth(depth);
+    /* calls at the same time share the pool or parse serially */
+    {
+        std::string text = repeated("{\"id\":7,\"tags\":[\"a\",\"b\"]}", 2000);
+        json expected = json::parse(text);
+        std::vector<std::thread> callers;
+        std::atomic<int> wrong{0};
+        for (int i = 0; i < 4; ++i)
+            callers.push_back(std::thread([&] {
+                for (int k = 0; k < 20; ++k)
+                    if (!(json::parse_parallel(text, 4) == expected))
+                        ++wrong;
+            }));
+        for (std::thread &t : callers)
+            t.join();
+        check(wrong == 0, "concurrent parse_parallel");
+    }
+
+    /* reading an integer as a double leaves it exact, -0 keeps its sign */
+    json big = json::parse("[9007199254740993,-0]");
+    json const &exact = big;
+    check(exact[0].get_number() == 9007199254740992.0 && exact[0].is_integer(), "get_number of an integer");
+    check(big.dump() == "[9007199254740993,-0.0]", "dump after get_number: " + big.dump());
+    /* through the mutable overload it becomes a double that can be written */
+    double &x = big[0].get_number();
+    x = 2.5;
+    check(!big[0].is_integer() && big.dump() == "[2.5,-0.0]", "write through get_number: " + big.dump());
+
+#ifdef JSON_HAS_MMAP
+    /* files that cannot be mapped are read: a pipe, and an empty file */
+    std::string fifo = "/tmp/json_tests_fifo_" + std::to_string(::getpid());
+    if (::mkfifo(fifo.c_str(), 0600) == 0) {
+        std::thread writer([&] {
+            std::ofstream out(fifo);
+            out << "{\"piped\":[1,2]}";
+        });
+        outcome piped = attempt([&] { return json::parse_file(fifo); });
+        writer.join();
+        ::unlink(fifo.c_str());
+        check(piped.ok && piped.tree == "{\"piped\":[1,2]}", "parse_file of a pipe: " + piped.describe());
+    }
+    std::string empty = fifo + ".json";
+    std::ofstream{empty};
+    outcome nothing = attempt([&] { return json::parse_file(empty); });
+    ::unlink(empty.c_str());
+    check(!nothing.ok && nothing.code == attempt([] { return json::parse(""); }).code, "parse_file of an empty file");
+#endif
+
+    thread_pool pool(4);
+    bool thrown = false;
+    try {
+        pool.run(100, [](std::size_t i) {
+            if (i == 57)
+                throw std::bad_alloc();
+        });
+    } catch (std::bad_alloc &) {
+        thrown = true;
+    }
+    check(thrown, "exception thrown by a task of the thread pool");
+
+    ndjson_events();
+    lazy_views();
+    cbor_strings();
+    path_wildcards();
+    paths();
+    decoding();
+    statistics();
+    mixed_numbers();
+    merging();
+    columnar();
+    borrowed_strings();
+    dictionary_iteration();
+    quiet_validation();
+
+    generator g;
+    round_trips(g);
+
+    std::printf("%d failures\n", failures);
+    return failures != 0;
+}